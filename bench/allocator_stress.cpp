@@ -0,0 +1,144 @@
+#include "obt_bench.hpp"
+
+#include "obt_buffer.hpp"
+#include "obt_device.hpp"
+#include "obt_window.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace obt;
+
+static constexpr uint32_t BUFFER_COUNT = 4096;
+static constexpr uint32_t CHURN_ROUNDS = 16;
+static constexpr VkDeviceSize MIN_BUFFER_SIZE = 256;
+static constexpr VkDeviceSize MAX_BUFFER_SIZE = 256 * 1024;
+// Stays well below maxMemoryAllocationCount, which is 4096 on many drivers
+static constexpr uint32_t DIRECT_BUFFER_COUNT = 1024;
+
+static constexpr VkBufferUsageFlags BUFFER_USAGE = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+// Log uniform sizes, small buffers are far more common than large ones
+static std::vector<VkDeviceSize> randomSizes(std::mt19937& rng, size_t count) {
+	std::uniform_real_distribution<double> exponent{std::log2(static_cast<double>(MIN_BUFFER_SIZE)), std::log2(static_cast<double>(MAX_BUFFER_SIZE))};
+	std::vector<VkDeviceSize> sizes(count);
+	for (auto& size : sizes) {
+		size = static_cast<VkDeviceSize>(std::exp2(exponent(rng)));
+	}
+	return sizes;
+}
+
+static void printStats(const char* phase, ObtDevice& device) {
+	constexpr double MB = 1024.0 * 1024.0;
+	ObtAllocator::Stats stats = device.getMemoryStats();
+	std::cout << std::fixed << std::setprecision(1) << phase << ": " << stats.blockCount << " blocks, "
+		<< stats.allocationCount << " allocations, " << stats.usedBytes / MB << " of " << stats.blockBytes / MB << " MB used, "
+		<< stats.dedicatedAllocationCount << " dedicated, fragmentation " << stats.fragmentation * 100.f << "%"
+		<< std::defaultfloat << std::endl;
+}
+
+static std::unique_ptr<ObtBuffer> createBuffer(ObtDevice& device, VkDeviceSize size) {
+	return std::make_unique<ObtBuffer>(device, size, 1, BUFFER_USAGE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+// The pooled allocator, buffers are created, churned by freeing and refilling random halves, and
+// destroyed again
+static void benchmarkPooled(ObtDevice& device, const std::vector<VkDeviceSize>& sizes, std::mt19937& rng) {
+	std::vector<std::unique_ptr<ObtBuffer>> buffers(BUFFER_COUNT);
+	size_t nextSize = 0;
+
+	ObtStopwatch stopwatch;
+	for (auto& buffer : buffers) {
+		buffer = createBuffer(device, sizes[nextSize++]);
+	}
+	printResult("pooled create", stopwatch.elapsedMs(), BUFFER_COUNT);
+	printStats("after create", device);
+
+	// Refilling with different sizes splits and merges free ranges the way streamed assets do
+	std::vector<uint32_t> order(BUFFER_COUNT);
+	std::iota(order.begin(), order.end(), 0u);
+	double freeMs = 0.0;
+	double createMs = 0.0;
+	uint64_t churned = 0;
+	for (uint32_t round = 0; round < CHURN_ROUNDS; round++) {
+		std::shuffle(order.begin(), order.end(), rng);
+		uint32_t half = BUFFER_COUNT / 2;
+
+		stopwatch.restart();
+		for (uint32_t i = 0; i < half; i++) {
+			buffers[order[i]].reset();
+		}
+		freeMs += stopwatch.elapsedMs();
+
+		stopwatch.restart();
+		for (uint32_t i = 0; i < half; i++) {
+			buffers[order[i]] = createBuffer(device, sizes[nextSize++]);
+		}
+		createMs += stopwatch.elapsedMs();
+		churned += half;
+	}
+	printResult("pooled churn free", freeMs, churned);
+	printResult("pooled churn create", createMs, churned);
+	printStats("after churn", device);
+
+	stopwatch.restart();
+	buffers.clear();
+	printResult("pooled destroy", stopwatch.elapsedMs(), BUFFER_COUNT);
+	printStats("after destroy", device);
+}
+
+// One vkAllocateMemory per buffer, what ObtDevice did before the allocator
+static void benchmarkDirect(ObtDevice& device, const std::vector<VkDeviceSize>& sizes) {
+	std::vector<VkBuffer> buffers(DIRECT_BUFFER_COUNT);
+	std::vector<VkDeviceMemory> memories(DIRECT_BUFFER_COUNT);
+
+	ObtStopwatch stopwatch;
+	for (uint32_t i = 0; i < DIRECT_BUFFER_COUNT; i++) {
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = sizes[i];
+		bufferInfo.usage = BUFFER_USAGE;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (vkCreateBuffer(device.device(), &bufferInfo, nullptr, &buffers[i]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create buffer!");
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(device.device(), buffers[i], &memRequirements);
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = device.findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		if (vkAllocateMemory(device.device(), &allocInfo, nullptr, &memories[i]) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate buffer memory!");
+		}
+		vkBindBufferMemory(device.device(), buffers[i], memories[i], 0);
+	}
+	printResult("direct create", stopwatch.elapsedMs(), DIRECT_BUFFER_COUNT);
+
+	stopwatch.restart();
+	for (uint32_t i = 0; i < DIRECT_BUFFER_COUNT; i++) {
+		vkDestroyBuffer(device.device(), buffers[i], nullptr);
+		vkFreeMemory(device.device(), memories[i], nullptr);
+	}
+	printResult("direct destroy", stopwatch.elapsedMs(), DIRECT_BUFFER_COUNT);
+}
+
+int main() {
+	ObtWindow window{64, 64, "allocator stress"};
+	ObtDevice device{window};
+
+	std::mt19937 rng{29};
+	std::vector<VkDeviceSize> sizes = randomSizes(rng, BUFFER_COUNT + static_cast<size_t>(BUFFER_COUNT / 2) * CHURN_ROUNDS);
+
+	std::cout << BUFFER_COUNT << " device local buffers of " << MIN_BUFFER_SIZE << " to " << MAX_BUFFER_SIZE << " bytes" << std::endl;
+	benchmarkPooled(device, sizes, rng);
+	benchmarkDirect(device, sizes);
+	return 0;
+}
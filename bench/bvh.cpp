@@ -0,0 +1,119 @@
+#include "obt_bench.hpp"
+
+#include "obt_bvh.hpp"
+#include "obt_camera.hpp"
+#include "obt_frustum_culling.hpp"
+#include "obt_job_system.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace obt;
+
+static constexpr uint32_t SCENE_SIZES[] = {10000, 100000, 1000000};
+static constexpr uint32_t RUNS = 5;
+static constexpr uint32_t RAY_COUNT = 10000;
+static constexpr uint32_t OVERLAP_QUERY_COUNT = 10000;
+static constexpr uint32_t CLUSTER_COUNT = 64;
+static constexpr float SCENE_EXTENT = 500.f;
+
+// Objects gathered around a few points, like props in rooms, which makes the split choice matter
+// far more than a uniform distribution does
+static std::vector<glm::vec4> clusteredSpheres(std::mt19937& rng, uint32_t count) {
+	std::vector<glm::vec4> centers = randomSpheres(rng, CLUSTER_COUNT, SCENE_EXTENT, 5.f, 40.f);
+	std::uniform_int_distribution<uint32_t> cluster{0, CLUSTER_COUNT - 1};
+	std::normal_distribution<float> offset{0.f, 1.f};
+	std::uniform_real_distribution<float> radius{0.5f, 2.f};
+
+	std::vector<glm::vec4> spheres(count);
+	for (auto& sphere : spheres) {
+		const glm::vec4& center = centers[cluster(rng)];
+		glm::vec3 position = glm::vec3{center} + glm::vec3{offset(rng), offset(rng), offset(rng)} * center.w;
+		sphere = glm::vec4{position, radius(rng)};
+	}
+	return spheres;
+}
+
+static void benchmarkScene(const std::string& name, const std::vector<glm::vec4>& spheres, ObtJobSystem& jobSystem, std::mt19937& rng) {
+	uint32_t count = static_cast<uint32_t>(spheres.size());
+	std::vector<uint32_t> flags(count, 1u);
+	std::string prefix = name + " " + std::to_string(count) + " ";
+	ObtBvh bvh{};
+
+	printResult(prefix + "build", benchmarkMs(RUNS, [&]() { bvh.build(spheres.data(), count); }), count);
+	printResult(prefix + "build parallel", benchmarkMs(RUNS, [&]() { bvh.build(spheres.data(), count, &jobSystem); }), count);
+	std::cout << prefix << "nodes " << bvh.getNodeCount() << ", cost " << bvh.getCost() << std::endl;
+
+	// Every object moves a little, the refit cost grows against the build cost
+	std::vector<glm::vec4> moved = spheres;
+	std::normal_distribution<float> jitter{0.f, 2.f};
+	for (auto& sphere : moved) {
+		sphere += glm::vec4{jitter(rng), jitter(rng), jitter(rng), 0.f};
+	}
+	printResult(prefix + "refit", benchmarkMs(RUNS, [&]() { bvh.refit(moved.data()); }), count);
+	printResult(prefix + "refit parallel", benchmarkMs(RUNS, [&]() { bvh.refit(moved.data(), &jobSystem); }), count);
+	std::cout << prefix << "cost after refit " << bvh.getCost() << (bvh.needsRebuild() ? ", rebuild due" : "") << std::endl;
+	bvh.build(moved.data(), count);
+
+	ObtCamera camera{};
+	camera.setPerspectiveProjection(glm::radians(50.f), 16.f / 9.f, 0.1f, SCENE_EXTENT);
+	camera.setViewTarget(glm::vec3{0.f, -50.f, -SCENE_EXTENT}, glm::vec3{0.f});
+	ObtFrustumPlanes planes = camera.getFrustumPlanes();
+	std::vector<uint32_t> visible;
+
+	printResult(prefix + "frustum cull linear parallel", benchmarkMs(RUNS, [&]() {
+		cullSpheres(planes, moved.data(), flags.data(), 1u, count, visible, &jobSystem);
+	}), count);
+	printResult(prefix + "frustum cull bvh", benchmarkMs(RUNS, [&]() {
+		bvh.cullFrustum(planes, flags.data(), 1u, visible);
+	}), count);
+	printResult(prefix + "frustum cull bvh parallel", benchmarkMs(RUNS, [&]() {
+		bvh.cullFrustum(planes, flags.data(), 1u, visible, &jobSystem);
+	}), count);
+	std::cout << prefix << visible.size() << " visible" << std::endl;
+
+	// Picking rays from the camera position through random points of the scene
+	std::uniform_real_distribution<float> position{-SCENE_EXTENT, SCENE_EXTENT};
+	std::vector<glm::vec3> targets(RAY_COUNT);
+	for (auto& target : targets) {
+		target = glm::vec3{position(rng), position(rng), position(rng)};
+	}
+	glm::vec3 origin{0.f, -50.f, -SCENE_EXTENT};
+	uint32_t hits = 0;
+	printResult(prefix + "raycast", benchmarkMs(RUNS, [&]() {
+		hits = 0;
+		for (const auto& target : targets) {
+			uint32_t hitIndex;
+			float hitDistance;
+			if (bvh.raycast(origin, target - origin, 4.f * SCENE_EXTENT, hitIndex, hitDistance)) hits++;
+		}
+	}), RAY_COUNT);
+	std::cout << prefix << hits << " of " << RAY_COUNT << " rays hit" << std::endl;
+
+	std::vector<glm::vec3> boxCenters(OVERLAP_QUERY_COUNT);
+	for (auto& center : boxCenters) {
+		center = glm::vec3{position(rng), position(rng), position(rng)};
+	}
+	std::vector<uint32_t> results;
+	size_t found = 0;
+	printResult(prefix + "overlap query", benchmarkMs(RUNS, [&]() {
+		found = 0;
+		for (const auto& center : boxCenters) {
+			bvh.queryOverlap(center - 10.f, center + 10.f, results);
+			found += results.size();
+		}
+	}), OVERLAP_QUERY_COUNT);
+	std::cout << prefix << found << " overlaps" << std::endl;
+}
+
+int main() {
+	std::mt19937 rng{42};
+	ObtJobSystem jobSystem{};
+	std::cout << jobSystem.getThreadCount() << " threads" << std::endl;
+
+	for (uint32_t count : SCENE_SIZES) {
+		benchmarkScene("uniform", randomSpheres(rng, count, SCENE_EXTENT, 0.5f, 2.f), jobSystem, rng);
+		benchmarkScene("clustered", clusteredSpheres(rng, count), jobSystem, rng);
+	}
+	return 0;
+}
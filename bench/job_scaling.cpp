@@ -0,0 +1,153 @@
+#include "obt_bench.hpp"
+
+#include "obt_camera.hpp"
+#include "obt_frustum_culling.hpp"
+#include "obt_job_system.hpp"
+#include "obt_model.hpp"
+#include "obt_scene.hpp"
+#include "obt_texture_atlas.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace obt;
+
+static constexpr uint32_t RUNS = 5;
+static constexpr uint32_t ROOT_COUNT = 1000;
+static constexpr uint32_t CHILDREN_PER_ROOT = 99;
+static constexpr uint32_t SPHERE_COUNT = 1000000;
+static constexpr uint32_t GRID_SIZE = 512;
+static constexpr uint32_t TEXTURE_COUNT = 32;
+static constexpr uint32_t TEXTURE_SIZE = 512;
+
+// A GRID_SIZE x GRID_SIZE vertex grid with positions, normals and texture coordinates, big enough
+// for the vertex processing to split into many load chunks
+static void writeGridObj(const std::string& path) {
+	std::ofstream file{path};
+	if (!file) throw std::runtime_error("Failed to write " + path);
+
+	for (uint32_t y = 0; y < GRID_SIZE; y++) {
+		for (uint32_t x = 0; x < GRID_SIZE; x++) {
+			float u = static_cast<float>(x) / (GRID_SIZE - 1);
+			float v = static_cast<float>(y) / (GRID_SIZE - 1);
+			file << "v " << u * 10.f << " " << (u - v) * (u + v) << " " << v * 10.f << "\n";
+			file << "vn 0 1 0\n";
+			file << "vt " << u << " " << v << "\n";
+		}
+	}
+	for (uint32_t y = 0; y + 1 < GRID_SIZE; y++) {
+		for (uint32_t x = 0; x + 1 < GRID_SIZE; x++) {
+			uint32_t a = y * GRID_SIZE + x + 1;
+			uint32_t b = a + 1;
+			uint32_t c = a + GRID_SIZE;
+			uint32_t d = c + 1;
+			file << "f " << a << "/" << a << "/" << a << " " << c << "/" << c << "/" << c << " " << b << "/" << b << "/" << b << "\n";
+			file << "f " << b << "/" << b << "/" << b << " " << c << "/" << c << "/" << c << " " << d << "/" << d << "/" << d << "\n";
+		}
+	}
+}
+
+// Uncompressed 32 bit TGA with noise, decoded by the same stb_image path as the real textures
+static void writeNoiseTga(const std::string& path, std::mt19937& rng) {
+	std::ofstream file{path, std::ios::binary};
+	if (!file) throw std::runtime_error("Failed to write " + path);
+
+	unsigned char header[18]{};
+	header[2] = 2;
+	header[12] = TEXTURE_SIZE & 0xff;
+	header[13] = TEXTURE_SIZE >> 8;
+	header[14] = TEXTURE_SIZE & 0xff;
+	header[15] = TEXTURE_SIZE >> 8;
+	header[16] = 32;
+	header[17] = 0x28;
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+	std::vector<unsigned char> pixels(TEXTURE_SIZE * TEXTURE_SIZE * 4);
+	std::uniform_int_distribution<int> channel{0, 255};
+	for (auto& value : pixels) value = static_cast<unsigned char>(channel(rng));
+	file.write(reinterpret_cast<const char*>(pixels.data()), static_cast<std::streamsize>(pixels.size()));
+}
+
+// Thread counts to measure, powers of two up to and including every hardware thread
+static std::vector<uint32_t> threadCounts() {
+	uint32_t maxThreads = ObtJobSystem::defaultWorkerCount() + 1;
+	std::vector<uint32_t> counts;
+	for (uint32_t threads = 1; threads < maxThreads; threads *= 2) counts.push_back(threads);
+	counts.push_back(maxThreads);
+	return counts;
+}
+
+int main() {
+	std::mt19937 rng{40};
+
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "obt_job_scaling";
+	std::filesystem::create_directories(directory);
+	std::string objPath = (directory / "grid.obj").string();
+	writeGridObj(objPath);
+	std::vector<std::string> texturePaths;
+	for (uint32_t i = 0; i < TEXTURE_COUNT; i++) {
+		texturePaths.push_back((directory / ("noise" + std::to_string(i) + ".tga")).string());
+		writeNoiseTga(texturePaths.back(), rng);
+	}
+
+	// Two level hierarchy, moving a root dirties its whole subtree
+	ObtScene scene{};
+	std::vector<ObtSceneHandle> roots(ROOT_COUNT);
+	for (auto& root : roots) {
+		root = scene.create();
+		for (uint32_t child = 0; child < CHILDREN_PER_ROOT; child++) {
+			scene.translation(scene.create(ObtScene::NO_MODEL, root)).x = static_cast<float>(child);
+		}
+	}
+	scene.updateTransforms();
+
+	std::vector<glm::vec4> spheres = randomSpheres(rng, SPHERE_COUNT, 500.f, 0.5f, 2.f);
+	ObtCamera camera{};
+	camera.setPerspectiveProjection(glm::radians(50.f), 1.f, 0.1f, 1000.f);
+	camera.setViewTarget(glm::vec3{0.f, 0.f, -500.f}, glm::vec3{0.f});
+	ObtFrustumPlanes planes = camera.getFrustumPlanes();
+	std::vector<uint32_t> visible;
+
+	std::cout << scene.size() << " scene objects, " << SPHERE_COUNT << " spheres, " << GRID_SIZE << "x" << GRID_SIZE << " vertex OBJ, "
+		<< TEXTURE_COUNT << " " << TEXTURE_SIZE << "x" << TEXTURE_SIZE << " textures" << std::endl;
+
+	for (uint32_t threads : threadCounts()) {
+		ObtJobSystem jobSystem{threads - 1};
+		std::string suffix = " (" + std::to_string(threads) + " threads)";
+
+		double transformMs = benchmarkMs(RUNS, [&]() {
+			for (const auto& root : roots) {
+				scene.translation(root).y += 0.01f;
+			}
+			scene.updateTransforms(&jobSystem);
+		});
+		printResult("transforms" + suffix, transformMs, scene.size());
+
+		double cullMs = benchmarkMs(RUNS, [&]() {
+			cullSpheres(planes, spheres.data(), nullptr, 0, SPHERE_COUNT, visible, &jobSystem);
+			doNotOptimize(visible.data());
+		});
+		printResult("frustum culling" + suffix, cullMs, SPHERE_COUNT);
+
+		double objMs = benchmarkMs(RUNS, [&]() {
+			ObtModel::Builder builder{};
+			builder.loadModel(objPath, &jobSystem);
+			doNotOptimize(builder.vertices.data());
+		});
+		printResult("obj loading" + suffix, objMs);
+
+		double textureMs = benchmarkMs(RUNS, [&]() {
+			ObtTextureAtlas::Builder builder{};
+			builder.loadTextures(texturePaths, &jobSystem);
+			doNotOptimize(builder.pixels.data());
+		});
+		printResult("texture decoding + packing" + suffix, textureMs, TEXTURE_COUNT);
+	}
+
+	std::filesystem::remove_all(directory);
+	return 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace obt {
+
+// Wall clock stopwatch for the benchmarks, started on construction
+class ObtStopwatch {
+	public:
+		ObtStopwatch() : start{std::chrono::steady_clock::now()} {}
+
+		void restart() { start = std::chrono::steady_clock::now(); }
+		double elapsedMs() const { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(); }
+
+	private:
+		std::chrono::steady_clock::time_point start;
+};
+
+// Runs function runs times and returns the fastest run in milliseconds, the fastest run is the one
+// least disturbed by the rest of the system
+template<typename F>
+double benchmarkMs(uint32_t runs, F&& function) {
+	double best = std::numeric_limits<double>::max();
+	for (uint32_t run = 0; run < std::max(runs, 1u); run++) {
+		ObtStopwatch stopwatch;
+		function();
+		best = std::min(best, stopwatch.elapsedMs());
+	}
+	return best;
+}
+
+// Prints one result line, with the time per operation when operations is given
+inline void printResult(const std::string& name, double ms, uint64_t operations = 0) {
+	std::cout << std::left << std::setw(52) << name << std::right << std::fixed << std::setprecision(3) << std::setw(12) << ms << " ms";
+	if (operations > 0) std::cout << std::setw(12) << ms * 1e6 / static_cast<double>(operations) << " ns/op";
+	std::cout << std::defaultfloat << std::endl;
+}
+
+// Synthetic scene of bounding spheres (center in xyz, radius in w) spread uniformly over a cube
+// of the given half extent around the origin
+inline std::vector<glm::vec4> randomSpheres(std::mt19937& rng, uint32_t count, float extent, float minRadius, float maxRadius) {
+	std::uniform_real_distribution<float> position{-extent, extent};
+	std::uniform_real_distribution<float> radius{minRadius, maxRadius};
+	std::vector<glm::vec4> spheres(count);
+	for (auto& sphere : spheres) {
+		sphere = glm::vec4{position(rng), position(rng), position(rng), radius(rng)};
+	}
+	return spheres;
+}
+
+// Keeps the compiler from dropping work whose result the benchmark never reads
+template<typename T>
+inline void doNotOptimize(const T& value) {
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+}
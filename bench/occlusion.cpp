@@ -0,0 +1,91 @@
+#include "obt_bench.hpp"
+
+#include "obt_occlusion_culling.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace obt;
+
+static constexpr uint32_t RUNS = 10;
+static constexpr uint32_t GRID_SIZE = 64;
+static constexpr uint32_t QUERY_COUNT = 100000;
+
+// Corners of the screen filling quad, clip space equals world space with an identity transform
+static const glm::vec3 QUAD_POSITIONS[] = {{-1.f, -1.f, 0.5f}, {1.f, -1.f, 0.5f}, {1.f, 1.f, 0.5f}, {-1.f, 1.f, 0.5f}};
+static const uint32_t QUAD_INDICES[] = {0, 1, 2, 0, 2, 3};
+
+// Box between the given pixel coordinates at a constant depth
+static bool isPixelBoxVisible(const ObtOcclusionCuller& culler, float minX, float maxX, float minY, float maxY, float depth) {
+	float width = static_cast<float>(culler.getWidth());
+	float height = static_cast<float>(culler.getHeight());
+	glm::vec3 boxMin{minX / width * 2.f - 1.f, minY / height * 2.f - 1.f, depth};
+	glm::vec3 boxMax{maxX / width * 2.f - 1.f, maxY / height * 2.f - 1.f, depth};
+	return culler.isVisible(glm::mat4{1.f}, boxMin, boxMax);
+}
+
+static void check(bool condition, const std::string& name) {
+	if (!condition) throw std::runtime_error("Occlusion check failed: " + name);
+}
+
+// Boxes at the buffer edges against a screen filling occluder, the answers must not depend on how
+// the screen bounds get clamped
+static void checkEdges() {
+	ObtOcclusionCuller culler{};
+	float width = static_cast<float>(culler.getWidth());
+	float height = static_cast<float>(culler.getHeight());
+	culler.renderOccluder(glm::mat4{1.f}, QUAD_POSITIONS, QUAD_INDICES, 6);
+
+	check(isPixelBoxVisible(culler, 10.f, 20.f, height - 0.7f, height - 0.1f, 0.2f), "box in front within the last row");
+	check(isPixelBoxVisible(culler, width - 0.7f, width - 0.1f, 10.f, 20.f, 0.2f), "box in front within the last column");
+	check(isPixelBoxVisible(culler, width - 0.5f, width + 20.f, height - 0.5f, height + 20.f, 0.2f), "box in front leaving the bottom right corner");
+	check(!isPixelBoxVisible(culler, 10.f, 20.f, height - 0.7f, height - 0.1f, 0.8f), "box behind within the last row");
+	check(!isPixelBoxVisible(culler, width + 1.f, width + 20.f, 10.f, 20.f, 0.2f), "box right of the screen");
+	check(!isPixelBoxVisible(culler, 10.f, 20.f, -20.f, -1.f, 0.2f), "box above the screen");
+	std::cout << "edge checks passed" << std::endl;
+}
+
+int main() {
+	checkEdges();
+
+	// Height field of occluders across the lower half of the screen, like terrain seen from above
+	std::vector<glm::vec3> positions;
+	for (uint32_t y = 0; y <= GRID_SIZE; y++) {
+		for (uint32_t x = 0; x <= GRID_SIZE; x++) {
+			float u = static_cast<float>(x) / GRID_SIZE;
+			float v = static_cast<float>(y) / GRID_SIZE;
+			positions.push_back(glm::vec3{u * 2.f - 1.f, v, 0.4f + 0.1f * u * v});
+		}
+	}
+	std::vector<uint32_t> indices;
+	for (uint32_t y = 0; y < GRID_SIZE; y++) {
+		for (uint32_t x = 0; x < GRID_SIZE; x++) {
+			uint32_t a = y * (GRID_SIZE + 1) + x;
+			uint32_t c = a + GRID_SIZE + 1;
+			indices.insert(indices.end(), {a, a + 1, c, a + 1, c + 1, c});
+		}
+	}
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+	ObtOcclusionCuller culler{};
+	double renderMs = benchmarkMs(RUNS, [&]() {
+		culler.clear();
+		culler.renderOccluder(glm::mat4{1.f}, positions.data(), indices.data(), static_cast<uint32_t>(indices.size()));
+	});
+	printResult("render occluder grid", renderMs, triangleCount);
+
+	std::mt19937 rng{43};
+	std::vector<glm::vec4> boxes = randomSpheres(rng, QUERY_COUNT, 1.f, 0.005f, 0.05f);
+	uint32_t visible = 0;
+	double queryMs = benchmarkMs(RUNS, [&]() {
+		visible = 0;
+		for (const auto& box : boxes) {
+			glm::vec3 center{box.x, box.y, 0.5f + 0.45f * box.z};
+			if (culler.isVisible(glm::mat4{1.f}, center - box.w, center + box.w)) visible++;
+		}
+	});
+	printResult("query boxes", queryMs, QUERY_COUNT);
+	std::cout << visible << " of " << QUERY_COUNT << " boxes visible" << std::endl;
+	return 0;
+}
@@ -0,0 +1,138 @@
+#include "obt_bench.hpp"
+
+#include "obt_game_object.hpp"
+#include "obt_scene.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace obt;
+
+static constexpr uint32_t OBJECT_COUNT = 100000;
+static constexpr uint32_t MOVED_FRACTION = 100;
+static constexpr uint32_t DESTROY_COUNT = 100;
+static constexpr uint32_t RUNS = 10;
+
+// The per object data the frame loop produced from vector<ObtGameObject> before the scene store
+struct AosTransform {
+	glm::mat4 modelMatrix;
+	glm::mat4 normalMatrix;
+};
+
+static void benchmarkAos(std::mt19937& rng) {
+	std::vector<ObtGameObject> objects;
+	std::uniform_real_distribution<float> position{-100.f, 100.f};
+
+	double createMs = benchmarkMs(1, [&]() {
+		objects.reserve(OBJECT_COUNT);
+		for (uint32_t i = 0; i < OBJECT_COUNT; i++) {
+			auto object = ObtGameObject::createGameObject();
+			object.transform.translation = {position(rng), position(rng), position(rng)};
+			objects.push_back(std::move(object));
+		}
+	});
+	printResult("aos create", createMs, OBJECT_COUNT);
+
+	std::vector<AosTransform> transforms(OBJECT_COUNT);
+	double updateMs = benchmarkMs(RUNS, [&]() {
+		for (uint32_t i = 0; i < OBJECT_COUNT; i++) {
+			objects[i].transform.translation.y += 0.01f;
+			transforms[i].modelMatrix = objects[i].transform.mat4();
+			transforms[i].normalMatrix = glm::mat4{objects[i].transform.normalMatrix()};
+		}
+		doNotOptimize(transforms.data());
+	});
+	printResult("aos move all + matrices", updateMs, OBJECT_COUNT);
+}
+
+static void benchmarkScene(std::mt19937& rng) {
+	ObtScene scene{};
+	std::vector<ObtSceneHandle> handles(OBJECT_COUNT);
+	std::uniform_real_distribution<float> position{-100.f, 100.f};
+
+	double createMs = benchmarkMs(1, [&]() {
+		for (auto& handle : handles) {
+			handle = scene.create();
+			scene.translation(handle) = {position(rng), position(rng), position(rng)};
+		}
+	});
+	printResult("scene create", createMs, OBJECT_COUNT);
+	scene.updateTransforms();
+
+	std::vector<uint32_t> changes;
+	double updateAllMs = benchmarkMs(RUNS, [&]() {
+		for (const auto& handle : handles) {
+			scene.translation(handle).y += 0.01f;
+		}
+		scene.updateTransforms();
+		scene.collectChanges(changes);
+		doNotOptimize(scene.getWorldTransforms().data());
+	});
+	printResult("scene move all + update + collect", updateAllMs, OBJECT_COUNT);
+
+	// Only a few objects move in a typical frame, unchanged ones must cost next to nothing
+	std::vector<ObtSceneHandle> moved;
+	std::sample(handles.begin(), handles.end(), std::back_inserter(moved), OBJECT_COUNT / MOVED_FRACTION, rng);
+	double updateSomeMs = benchmarkMs(RUNS, [&]() {
+		for (const auto& handle : moved) {
+			scene.translation(handle).y += 0.01f;
+		}
+		scene.updateTransforms();
+		scene.collectChanges(changes);
+		doNotOptimize(changes.data());
+	});
+	printResult("scene move 1% + update + collect", updateSomeMs, moved.size());
+
+	// Streams the dense arrays the way upload and culling passes read them
+	double streamMs = benchmarkMs(RUNS, [&]() {
+		const auto& transforms = scene.getWorldTransforms();
+		const auto& flags = scene.getFlags();
+		float sum = 0.f;
+		for (uint32_t i = 0; i < scene.size(); i++) {
+			if (flags[i] & ObtScene::FLAG_VISIBLE) sum += transforms[i].modelMatrix[3].y;
+		}
+		doNotOptimize(sum);
+	});
+	printResult("scene stream visible transforms", streamMs, scene.size());
+
+	std::vector<ObtSceneHandle> shuffled = handles;
+	std::shuffle(shuffled.begin(), shuffled.end(), rng);
+	double lookupMs = benchmarkMs(RUNS, [&]() {
+		uint32_t sum = 0;
+		for (const auto& handle : shuffled) {
+			sum += scene.indexOf(handle);
+		}
+		doNotOptimize(sum);
+	});
+	printResult("scene random handle lookup", lookupMs, shuffled.size());
+
+	std::vector<ObtSceneHandle> destroyed(shuffled.begin(), shuffled.begin() + DESTROY_COUNT);
+	double churnMs = benchmarkMs(1, [&]() {
+		for (const auto& handle : destroyed) {
+			scene.destroy(handle);
+		}
+		for (uint32_t i = 0; i < DESTROY_COUNT; i++) {
+			scene.create();
+		}
+		scene.updateTransforms();
+	});
+	printResult("scene destroy + recreate", churnMs, DESTROY_COUNT);
+
+	uint32_t stale = 0;
+	for (const auto& handle : destroyed) {
+		if (!scene.isValid(handle)) stale++;
+	}
+	std::cout << stale << " of " << DESTROY_COUNT << " destroyed handles report stale" << std::endl;
+}
+
+int main() {
+	std::mt19937 rng{36};
+
+	std::cout << OBJECT_COUNT << " objects" << std::endl;
+	benchmarkAos(rng);
+	benchmarkScene(rng);
+	return 0;
+}
@@ -0,0 +1,82 @@
+#include "obt_bench.hpp"
+
+#include "obt_buffer.hpp"
+#include "obt_device.hpp"
+#include "obt_stream_copy.hpp"
+#include "obt_window.hpp"
+
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace obt;
+
+static constexpr size_t COPY_SIZES[] = {4 * 1024, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024};
+static constexpr size_t BYTES_PER_RUN = 256 * 1024 * 1024;
+static constexpr uint32_t RUNS = 5;
+
+static void printBandwidth(const std::string& name, double ms, size_t bytes) {
+	double gigabytesPerSecond = static_cast<double>(bytes) / (ms * 1e-3) / 1e9;
+	std::cout << std::left << std::setw(52) << name << std::right << std::fixed << std::setprecision(2)
+		<< std::setw(12) << gigabytesPerSecond << " GB/s" << std::defaultfloat << std::endl;
+}
+
+// Copies the same source over dst repeatedly until BYTES_PER_RUN bytes were written, with both
+// memcpy and streamCopy
+static void benchmarkCopies(const std::string& memoryName, void* dst, const char* src) {
+	for (size_t size : COPY_SIZES) {
+		size_t repeats = BYTES_PER_RUN / size;
+		double memcpyMs = benchmarkMs(RUNS, [&]() {
+			for (size_t i = 0; i < repeats; i++) {
+				std::memcpy(dst, src, size);
+				doNotOptimize(dst);
+			}
+		});
+		double streamMs = benchmarkMs(RUNS, [&]() {
+			for (size_t i = 0; i < repeats; i++) {
+				streamCopy(dst, src, size);
+				doNotOptimize(dst);
+			}
+		});
+
+		std::string suffix = " " + memoryName + " " + std::to_string(size / 1024) + " KB";
+		printBandwidth("memcpy" + suffix, memcpyMs, repeats * size);
+		printBandwidth("streamCopy" + suffix, streamMs, repeats * size);
+	}
+}
+
+// Mapped memory of the given properties, or nullptr when the device has no such memory type
+static std::unique_ptr<ObtBuffer> createMappedBuffer(ObtDevice& device, size_t size, VkMemoryPropertyFlags properties) {
+	std::unique_ptr<ObtBuffer> buffer;
+	try {
+		buffer = std::make_unique<ObtBuffer>(device, size, 1, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, properties);
+	} catch (const std::runtime_error&) {
+		return nullptr;
+	}
+	buffer->map();
+	return buffer;
+}
+
+int main() {
+	size_t maxSize = COPY_SIZES[sizeof(COPY_SIZES) / sizeof(COPY_SIZES[0]) - 1];
+	std::vector<char> source(maxSize, 1);
+	std::vector<char> cached(maxSize);
+	benchmarkCopies("heap", cached.data(), source.data());
+
+	ObtWindow window{64, 64, "stream copy"};
+	ObtDevice device{window};
+
+	auto hostCached = createMappedBuffer(device, maxSize, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+	if (hostCached) {
+		benchmarkCopies("host cached", hostCached->getMappedMemory(), source.data());
+	} else {
+		std::cout << "no host cached coherent memory type, skipped" << std::endl;
+	}
+
+	// The memory type the per-frame uploads use, write-combined on most discrete GPUs
+	auto upload = createMappedBuffer(device, maxSize, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	benchmarkCopies(upload->isWriteCombined() ? "write-combined" : "upload (cached)", upload->getMappedMemory(), source.data());
+	return 0;
+}
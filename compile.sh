@@ -3,3 +3,5 @@
 mkdir -p res/shaders
 glslangValidator -V src/shaders/shader.vert -o res/shaders/shader.vert.spv
 glslangValidator -V src/shaders/shader.frag -o res/shaders/shader.frag.spv
+glslangValidator -V src/shaders/cull.comp -o res/shaders/cull.comp.spv
+glslangValidator -V src/shaders/depth_reduce.comp -o res/shaders/depth_reduce.comp.spv
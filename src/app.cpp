@@ -1,10 +1,14 @@
 #include "app.hpp"
 
 #include "simple_render_system.hpp"
+#include "gpu_cull_system.hpp"
 #include "obt_camera.hpp"
 #include "keyboard_controller.hpp"
 #include "obt_buffer.hpp"
 #include "obt_image.hpp"
+#include "obt_growable_buffer.hpp"
+#include "obt_stream_copy.hpp"
+#include "obt_occlusion_culling.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -14,7 +18,10 @@
 #include <stdexcept>
 #include <array>
 #include <chrono>
+#include <cstring>
+#include <iostream>
 #include <numeric>
+#include <algorithm>
 
 namespace obt {
 
@@ -28,12 +35,10 @@ struct SceneData {
 	float ambient = .04f;
 	alignas(16) glm::vec3 lightPos{1.f, -3.f, -1.f};
 	alignas(16) glm::vec3 camPos{};
+	int lightCount = 0;
 };
 
-struct ObjectData {
-	glm::mat4 modelMatrix{1.f};
-	glm::mat4 normalMatrix{1.f};
-};
+using ObjectData = ObtWorldTransform;
 
 struct LightData {
 	glm::vec3 position{-1.f};
@@ -46,6 +51,7 @@ App::App() {
 		.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, ObtSwapChain::MAX_FRAMES_IN_FLIGHT * 10)
 		.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, ObtSwapChain::MAX_FRAMES_IN_FLIGHT * 10)
 		.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, ObtSwapChain::MAX_FRAMES_IN_FLIGHT * 10)
+		.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, ObtSwapChain::MAX_FRAMES_IN_FLIGHT * 10)
 		.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, ObtSwapChain::MAX_FRAMES_IN_FLIGHT * 10)
 		.build();
 
@@ -55,78 +61,123 @@ App::App() {
 App::~App() {}
 
 void App::run() {
-	std::unique_ptr<ObtSampler> sampler = std::make_unique<ObtSampler>(obtDevice);
+	std::shared_ptr<ObtSampler> sampler = samplerCache.getSampler();
 	std::unique_ptr<ObtImage> texture = std::make_unique<ObtImage>(obtDevice, "res/textures/teapot.jpg");
 
-	auto minOffsetAlignment = std::lcm(
-		obtDevice.properties.limits.minUniformBufferOffsetAlignment,
-		obtDevice.properties.limits.nonCoherentAtomSize);
-
-	std::vector<std::unique_ptr<ObtBuffer>> cameraUboBuffers(ObtSwapChain::MAX_FRAMES_IN_FLIGHT);
-	std::vector<std::unique_ptr<ObtBuffer>> objectSboBuffers(ObtSwapChain::MAX_FRAMES_IN_FLIGHT);
-	std::vector<std::unique_ptr<ObtBuffer>> lightSboBuffers(ObtSwapChain::MAX_FRAMES_IN_FLIGHT);
-	for (int i = 0; i < cameraUboBuffers.size(); ++i) {
-		cameraUboBuffers[i] = std::make_unique<ObtBuffer>(obtDevice, sizeof(CameraData), 1, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-		cameraUboBuffers[i]->map();
-
-		objectSboBuffers[i] = std::make_unique<ObtBuffer>(obtDevice, sizeof(ObjectData) * 10000, 1, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-		objectSboBuffers[i]->map();
+	std::vector<std::unique_ptr<ObtGrowableBuffer>> objectSboBuffers(ObtSwapChain::MAX_FRAMES_IN_FLIGHT);
+	std::vector<std::unique_ptr<ObtGrowableBuffer>> instanceSboBuffers(ObtSwapChain::MAX_FRAMES_IN_FLIGHT);
+	for (int i = 0; i < objectSboBuffers.size(); ++i) {
+		objectSboBuffers[i] = std::make_unique<ObtGrowableBuffer>(obtDevice, sizeof(ObjectData), scene.size());
+		instanceSboBuffers[i] = std::make_unique<ObtGrowableBuffer>(obtDevice, sizeof(uint32_t), scene.size());
+	}
 
-		lightSboBuffers[i] = std::make_unique<ObtBuffer>(obtDevice, sizeof(LightData) * 100, 1, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-		lightSboBuffers[i]->map(); }
-	std::unique_ptr<ObtBuffer> sceneUboBuffer = std::make_unique<ObtBuffer>(
-		obtDevice, sizeof(SceneData), ObtSwapChain::MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, minOffsetAlignment);
-	sceneUboBuffer->map();
+	// Devices without indirect draw counts keep culling on the CPU
+	std::unique_ptr<GpuCullSystem> gpuCullSystem{};
+	if (GPU_CULLING && obtDevice.isDrawIndirectCountSupported()) {
+		gpuCullSystem = std::make_unique<GpuCullSystem>(obtDevice, ObtSwapChain::MAX_FRAMES_IN_FLIGHT);
+	}
 
 	auto globalSetLayout = ObtDescriptorSetLayout::Builder(obtDevice)
-		.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+		.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT)
 		.addBinding(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT)
 		.addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
 		.build();
 
 	auto objectSetLayout = ObtDescriptorSetLayout::Builder(obtDevice)
 		.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+		.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
 		.build();
 
 	auto lightSetLayout = ObtDescriptorSetLayout::Builder(obtDevice)
-		.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+		.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT)
 		.build();
 
 	std::vector<VkDescriptorSet> globalDescriptorSets(ObtSwapChain::MAX_FRAMES_IN_FLIGHT);
 	std::vector<VkDescriptorSet> objectDescriptorSets(ObtSwapChain::MAX_FRAMES_IN_FLIGHT);
 	std::vector<VkDescriptorSet> lightDescriptorSets(ObtSwapChain::MAX_FRAMES_IN_FLIGHT);
-	for (int i = 0; i < globalDescriptorSets.size(); ++i) {
-		auto cameraInfo = cameraUboBuffers[i]->descriptorInfo();
-		auto sceneInfo = sceneUboBuffer->descriptorInfo(sizeof(SceneData), 0);
+	std::vector<uint32_t> frameAllocatorGenerations(ObtSwapChain::MAX_FRAMES_IN_FLIGHT);
+	std::vector<uint32_t> textureGenerations(ObtSwapChain::MAX_FRAMES_IN_FLIGHT);
+	std::vector<uint32_t> objectSboGenerations(ObtSwapChain::MAX_FRAMES_IN_FLIGHT);
+	std::vector<uint32_t> instanceSboGenerations(ObtSwapChain::MAX_FRAMES_IN_FLIGHT);
+	// Rewriting a set invalidates command buffers that bound it, cached commands are re-recorded
+	uint64_t descriptorRewrites = 0;
+
+	// Sets are rewritten whenever the frame allocator grew that frame's buffer or the texture was
+	// moved by the defragmenter
+	auto writeFrameDescriptors = [&](int i, bool allocate) {
+		auto cameraInfo = frameAllocator.descriptorInfo(i, sizeof(CameraData));
+		auto sceneInfo = frameAllocator.descriptorInfo(i, sizeof(SceneData));
 		auto imageInfo = texture->descriptorInfo(sampler->getSampler());
-		ObtDescriptorWriter(*globalSetLayout, *globalPool)
+		auto globalWriter = ObtDescriptorWriter(*globalSetLayout, *globalPool)
 			.writeBuffer(0, &cameraInfo)
 			.writeBuffer(1, &sceneInfo)
-			.writeImage(2, &imageInfo)
-			.build(globalDescriptorSets[i]);
-
-		auto objectInfo = objectSboBuffers[i]->descriptorInfo(sizeof(ObjectData)*10000, 0);
-		ObtDescriptorWriter(*objectSetLayout, *globalPool)
+			.writeImage(2, &imageInfo);
+
+		auto lightInfo = frameAllocator.descriptorInfo(i);
+		auto lightWriter = ObtDescriptorWriter(*lightSetLayout, *globalPool)
+			.writeBuffer(0, &lightInfo);
+
+		if (allocate) {
+			globalWriter.build(globalDescriptorSets[i]);
+			lightWriter.build(lightDescriptorSets[i]);
+		} else {
+			globalWriter.overwrite(globalDescriptorSets[i]);
+			lightWriter.overwrite(lightDescriptorSets[i]);
+			descriptorRewrites++;
+		}
+		frameAllocatorGenerations[i] = frameAllocator.getGeneration(i);
+		textureGenerations[i] = texture->getGeneration();
+	};
+
+	// Instances are listed by the GPU cull pass when it runs, by the CPU otherwise
+	auto instanceSboGeneration = [&](int i) {
+		return gpuCullSystem ? gpuCullSystem->getInstanceGeneration(i) : instanceSboBuffers[i]->getGeneration();
+	};
+
+	auto writeObjectDescriptors = [&](int i, bool allocate) {
+		auto objectInfo = objectSboBuffers[i]->descriptorInfo();
+		auto instanceInfo = gpuCullSystem ? gpuCullSystem->instanceDescriptorInfo(i) : instanceSboBuffers[i]->descriptorInfo();
+		auto objectWriter = ObtDescriptorWriter(*objectSetLayout, *globalPool)
 			.writeBuffer(0, &objectInfo)
-			.build(objectDescriptorSets[i]);
+			.writeBuffer(1, &instanceInfo);
+
+		if (allocate) {
+			objectWriter.build(objectDescriptorSets[i]);
+		} else {
+			objectWriter.overwrite(objectDescriptorSets[i]);
+			descriptorRewrites++;
+		}
+		objectSboGenerations[i] = objectSboBuffers[i]->getGeneration();
+		instanceSboGenerations[i] = instanceSboGeneration(i);
+	};
 
-		auto lightInfo = lightSboBuffers[i]->descriptorInfo(sizeof(LightData)*100, 0);
-		ObtDescriptorWriter(*lightSetLayout, *globalPool)
-			.writeBuffer(0, &lightInfo)
-			.build(lightDescriptorSets[i]);
+	for (int i = 0; i < globalDescriptorSets.size(); ++i) {
+		writeFrameDescriptors(i, true);
+		writeObjectDescriptors(i, true);
 	}
 
 	std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
 		globalSetLayout->getDescriptorSetLayout(),
 		objectSetLayout->getDescriptorSetLayout(),
 		lightSetLayout->getDescriptorSetLayout()};
-	SimpleRenderSystem simpleRenderSystem{obtDevice, obtRenderer.getSwapChainRenderPass(), descriptorSetLayouts};
+	SimpleRenderSystem simpleRenderSystem{obtDevice, obtRenderer.getSwapChainRenderPass(), descriptorSetLayouts, ObtSwapChain::MAX_FRAMES_IN_FLIGHT};
+	obtRenderer.setCommandCachingEnabled(CACHE_COMMAND_BUFFERS);
 	ObtCamera camera{};
 	camera.setViewTarget(glm::vec3{-1.f, -2.f, -2.f}, glm::vec3{0.f, 0.f, 2.5f});
 
 	auto viewerObject = ObtGameObject::createGameObject();
 	KeyboardController cameraController{};
 
+	float memoryLogTimer = 0.f;
+
+	// Per-frame arrays are built in cached memory and streamed to the mapped buffers in one pass
+	std::vector<LightData> lightScratch;
+	std::vector<uint32_t> changedObjects;
+	std::vector<uint32_t> visibleObjects;
+	std::vector<uint32_t> instanceScratch;
+	std::vector<SimpleRenderSystem::InstanceBatch> instanceBatches;
+	ObtOcclusionCuller occlusionCuller{};
+
 	auto currentTime = std::chrono::high_resolution_clock::now();
 	while(!obtWindow.shouldClose()) {
 		glfwPollEvents();
@@ -135,6 +186,17 @@ void App::run() {
 		float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime-currentTime).count();
 		currentTime = newTime;
 
+		memoryLogTimer += frameTime;
+		if (memoryLogTimer >= MEMORY_LOG_INTERVAL) {
+			obtDevice.logMemoryBudget();
+			if (gpuCullSystem) {
+				std::cout << "culling: " << scene.size() << " objects culled on the GPU" << std::endl;
+			} else {
+				std::cout << "culling: " << visibleObjects.size() << " of " << scene.size() << " objects visible" << std::endl;
+			}
+			memoryLogTimer = 0.f;
+		}
+
 		cameraController.moveXZ(obtWindow.getGLFWwindow(), viewerObject, frameTime);
 		camera.setViewQuat(viewerObject.transform.translation, viewerObject.transform.rotation);
 
@@ -143,60 +205,138 @@ void App::run() {
 
 		if (auto commandBuffer = obtRenderer.beginFrame()) {
 			int frameIndex = obtRenderer.getFrameIndex();
-			uint32_t dynamicOffsets = sceneUboBuffer->getAlignmentSize()*frameIndex;
-			std::vector<VkDescriptorSet> descriptorSets{
-				globalDescriptorSets[frameIndex],
-				objectDescriptorSets[frameIndex],
-				lightDescriptorSets[frameIndex]};
-			FrameInfo frameInfo{frameIndex, frameTime, commandBuffer, camera, descriptorSets, dynamicOffsets};
+			frameAllocator.beginFrame(frameIndex);
+			defragmenter.step(commandBuffer);
 
 			CameraData camData{};
 			camData.proj = camera.getProjection();
 			camData.view = camera.getView();
 			camData.projView = camData.proj*camData.view;
-			cameraUboBuffers[frameIndex]->writeToBuffer(&camData);
-			cameraUboBuffers[frameIndex]->flush();
+			ObtFrameAllocator::Allocation cameraAllocation;
+			*frameAllocator.allocate<CameraData>(1, cameraAllocation) = camData;
 
 			SceneData sceneData{};
 			sceneData.camPos = viewerObject.transform.translation;
-			sceneUboBuffer->writeToIndex(&sceneData, frameIndex);
-			sceneUboBuffer->flushIndex(frameIndex);
-
-			ObjectData* objectData = (ObjectData*)objectSboBuffers[frameIndex]->getMappedMemory();
-			for (int i = 0; i < gameObjects.size(); ++i) {
-				auto& obj = gameObjects[i];
-				objectData[i].modelMatrix = obj.transform.mat4();
-				objectData[i].normalMatrix = obj.transform.normalMatrix();
-			}
+			sceneData.lightCount = static_cast<int>(pointLights.size());
+			ObtFrameAllocator::Allocation sceneAllocation;
+			*frameAllocator.allocate<SceneData>(1, sceneAllocation) = sceneData;
 
-			LightData* lightData = (LightData*)lightSboBuffers[frameIndex]->getMappedMemory();
+			lightScratch.resize(pointLights.size());
 			for (int i = 0; i < pointLights.size(); ++i) {
 				auto& light = pointLights[i];
-				lightData[i].position = light.transform.translation;
-				lightData[i].color = glm::vec4{light.color.x, light.color.y, light.color.z, 1.f};
+				lightScratch[i].position = light.transform.translation;
+				lightScratch[i].color = glm::vec4{light.color.x, light.color.y, light.color.z, 1.f};
+			}
+			ObtFrameAllocator::Allocation lightAllocation = frameAllocator.allocate(sizeof(LightData) * lightScratch.size());
+			streamCopy(lightAllocation.data, lightScratch.data(), sizeof(LightData) * lightScratch.size());
+			frameAllocator.flush();
+
+			// The frame's fence has been waited on, so its object buffer can be reallocated here
+			auto& objectSbo = *objectSboBuffers[frameIndex];
+			objectSbo.reserve(scene.size());
+
+			ObtBuffer& objectBuffer = objectSbo.getBuffer();
+			ObjectData* objects = objectSbo.data<ObjectData>();
+			auto& worldTransforms = scene.getWorldTransforms();
+
+			// Only objects whose world transform changed since this frame's buffer was last written
+			// are copied, consecutive indices are batched into one run
+			scene.updateTransforms(&jobSystem);
+			scene.collectChanges(changedObjects);
+			for (size_t begin = 0; begin < changedObjects.size();) {
+				size_t end = begin + 1;
+				while (end < changedObjects.size() && changedObjects[end] == changedObjects[end - 1] + 1) ++end;
+
+				uint32_t first = changedObjects[begin];
+				VkDeviceSize size = sizeof(ObjectData) * (end - begin);
+				if (objectBuffer.isWriteCombined()) {
+					streamCopy(objects + first, worldTransforms.data() + first, size);
+				} else {
+					std::memcpy(objects + first, worldTransforms.data() + first, size);
+				}
+				objectBuffer.markDirty(size, sizeof(ObjectData) * first);
+				begin = end;
+			}
+			objectBuffer.flushDirty();
+
+			if (gpuCullSystem) {
+				gpuCullSystem->updateObjects(frameIndex, scene, changedObjects);
+				gpuCullSystem->cull(commandBuffer, frameIndex, camera, obtRenderer.getSwapChainExtent());
+			} else {
+				scene.getBvh().cullFrustum(camera.getFrustumPlanes(), scene.getFlags().data(), ObtScene::FLAG_VISIBLE, visibleObjects, &jobSystem);
+
+				// Visible occluders are rasterized first, then every visible object is tested against them
+				occlusionCuller.clear();
+				bool hasOccluders = false;
+				for (uint32_t i : visibleObjects) {
+					if ((scene.getFlags()[i] & ObtScene::FLAG_OCCLUDER) == 0) continue;
+					const auto& mesh = scene.getModel(scene.getModelIds()[i])->getOccluderMesh();
+					occlusionCuller.renderOccluder(camData.projView * scene.getWorldTransforms()[i].modelMatrix, mesh.positions.data(), mesh.indices.data(), static_cast<uint32_t>(mesh.indices.size()));
+					hasOccluders = hasOccluders || !mesh.indices.empty();
+				}
+				if (hasOccluders) {
+					const auto& bounds = scene.getWorldBounds();
+					visibleObjects.erase(std::remove_if(visibleObjects.begin(), visibleObjects.end(), [&](uint32_t i) {
+						glm::vec3 center{bounds[i]};
+						return !occlusionCuller.isVisible(camData.projView, center - bounds[i].w, center + bounds[i].w);
+					}), visibleObjects.end());
+				}
+
+				// Draws are sorted by state, objects sharing a model are drawn as one instanced draw over a
+				// contiguous instance range
+				simpleRenderSystem.sortDraws(scene, camera, visibleObjects, instanceScratch, instanceBatches);
+				auto& instanceSbo = *instanceSboBuffers[frameIndex];
+				instanceSbo.reserve(static_cast<uint32_t>(instanceScratch.size()));
+				instanceSbo.getBuffer().writeToBuffer(instanceScratch.data(), sizeof(uint32_t) * instanceScratch.size());
+				instanceSbo.getBuffer().flushDirty();
+			}
+
+			if (objectSboGenerations[frameIndex] != objectSbo.getGeneration() || instanceSboGenerations[frameIndex] != instanceSboGeneration(frameIndex)) {
+				writeObjectDescriptors(frameIndex, false);
+			}
+
+			if (frameAllocatorGenerations[frameIndex] != frameAllocator.getGeneration(frameIndex) || textureGenerations[frameIndex] != texture->getGeneration()) {
+				writeFrameDescriptors(frameIndex, false);
 			}
 
-			obtRenderer.beginSwapChainRenderPass(commandBuffer);
-			simpleRenderSystem.renderGameObjects(frameInfo, gameObjects);
+			std::vector<VkDescriptorSet> descriptorSets{
+				globalDescriptorSets[frameIndex],
+				objectDescriptorSets[frameIndex],
+				lightDescriptorSets[frameIndex]};
+			std::vector<uint32_t> dynamicOffsets{cameraAllocation.offset, sceneAllocation.offset, lightAllocation.offset};
+			// All counters only grow, so their sum changes whenever any of them does
+			uint64_t resourceVersion = descriptorRewrites + defragmenter.getMovedBytes() + geometryPool.getGeneration();
+			FrameInfo frameInfo{frameIndex, frameTime, commandBuffer, camera, descriptorSets, dynamicOffsets, resourceVersion};
+
+			if (gpuCullSystem) {
+				obtRenderer.beginSwapChainRenderPass(commandBuffer);
+				simpleRenderSystem.renderIndirect(frameInfo, scene, *gpuCullSystem);
+			} else {
+				// CPU batches are recorded by the job system into secondary command buffers
+				obtRenderer.beginSwapChainRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+				simpleRenderSystem.renderScene(frameInfo, scene, instanceBatches, &obtRenderer, &jobSystem);
+			}
 			obtRenderer.endSwapChainRenderPass(commandBuffer);
+			if (gpuCullSystem) {
+				gpuCullSystem->buildDepthPyramid(commandBuffer, frameIndex, obtRenderer.getCurrentDepthImageView(), camData.projView);
+			}
 			obtRenderer.endFrame();
 		}
 	}
 
-	vkDeviceWaitIdle(obtDevice.device());
+	obtDevice.waitIdle();
 }
 
 void App::loadGameObjects() {
-	std::shared_ptr<ObtModel> floorModel = ObtModel::createModelFromFile(obtDevice, "res/models/floor.obj");
-	std::shared_ptr<ObtModel> teapotModel = ObtModel::createModelFromFile(obtDevice, "res/models/teapot.obj");
-
-	auto floor = ObtGameObject::createGameObject();
-	floor.model = floorModel;
-	gameObjects.push_back(std::move(floor));
-
-	auto teapot = ObtGameObject::createGameObject();
-	teapot.model = teapotModel;
-	gameObjects.push_back(std::move(teapot));
+	ObtModel::Builder floorBuilder{};
+	floorBuilder.loadModel("res/models/floor.obj", &jobSystem);
+	std::shared_ptr<ObtModel> floorModel = std::make_shared<ObtModel>(obtDevice, floorBuilder, &geometryPool);
+	floorModel->setOccluderMesh(floorBuilder.createOccluderMesh());
+	std::shared_ptr<ObtModel> teapotModel = ObtModel::createModelFromFile(obtDevice, "res/models/teapot.obj", &jobSystem, &geometryPool);
+
+	ObtSceneHandle floor = scene.create(scene.addModel(floorModel));
+	scene.flags(floor) |= ObtScene::FLAG_OCCLUDER;
+	scene.create(scene.addModel(teapotModel));
 
 	for (int i = 0; i < 2; ++i) {
 		auto light = ObtGameObject::createGameObject();
@@ -3,8 +3,14 @@
 #include "obt_window.hpp"
 #include "obt_device.hpp"
 #include "obt_game_object.hpp"
+#include "obt_scene.hpp"
 #include "obt_renderer.hpp"
 #include "obt_descriptors.hpp"
+#include "obt_sampler_cache.hpp"
+#include "obt_frame_allocator.hpp"
+#include "obt_defragmenter.hpp"
+#include "obt_job_system.hpp"
+#include "obt_geometry_pool.hpp"
 
 #include <memory>
 #include <vector>
@@ -15,6 +21,13 @@ class App {
 	public:
 		static constexpr int WIDTH = 800;
 		static constexpr int HEIGHT = 600;
+		static constexpr float MEMORY_LOG_INTERVAL = 10.f;
+		// Reuse scene command buffers while the draw list does not change, worth it for mostly static
+		// scenes since camera and transforms live in buffers
+		static constexpr bool CACHE_COMMAND_BUFFERS = true;
+		// Opts into culling and building the draw list on the GPU, which also needs indirect draw count
+		// support. When off or unsupported, culling, sorting and recording stay on the CPU
+		static constexpr bool GPU_CULLING = false;
 
 		App();
 		~App();
@@ -29,10 +42,16 @@ class App {
 
 		ObtWindow obtWindow{WIDTH, HEIGHT, "Orbit"};
 		ObtDevice obtDevice{obtWindow};
-		ObtRenderer obtRenderer{obtWindow, obtDevice};
+		ObtJobSystem jobSystem{};
+		ObtRenderer obtRenderer{obtWindow, obtDevice, jobSystem.getThreadCount()};
+		ObtSamplerCache samplerCache{obtDevice};
+		ObtFrameAllocator frameAllocator{obtDevice};
+		ObtDefragmenter defragmenter{obtDevice};
+		// Shared geometry lets the draws of all models go out as one indirect draw
+		ObtGeometryPool geometryPool{obtDevice, sizeof(ObtModel::Vertex)};
 
 		std::unique_ptr<ObtDescriptorPool> globalPool{};
-		std::vector<ObtGameObject> gameObjects;
+		ObtScene scene{ObtSwapChain::MAX_FRAMES_IN_FLIGHT};
 		std::vector<ObtGameObject> pointLights;
 };
 
@@ -0,0 +1,442 @@
+#include "gpu_cull_system.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace obt {
+
+struct CullData {
+	ObtFrustumPlanes planes;
+	glm::mat4 pyramidProjView{1.f};
+	glm::vec2 pyramidSize{0.f};
+	uint32_t objectCount = 0;
+	uint32_t occlusionEnabled = 0;
+};
+
+struct CullObject {
+	glm::vec4 sphere;
+	uint32_t modelId;
+	uint32_t flags;
+	uint32_t padding[2];
+};
+
+struct DrawModel {
+	uint32_t indexCount;
+	uint32_t firstCommand;
+};
+
+static uint32_t grownCapacity(uint32_t capacity, uint32_t count) {
+	while (capacity < count) capacity *= 2;
+	return capacity;
+}
+
+GpuCullSystem::GpuCullSystem(ObtDevice& device, uint32_t framesInFlight) : obtDevice{device}, framesInFlight{framesInFlight} {
+	assert(obtDevice.isDrawIndirectCountSupported() && "GPU culling needs indirect draws with a draw count");
+
+	createDescriptorSetLayouts();
+	createPipelines();
+	createFrameResources();
+	pyramidSampler = std::make_unique<ObtSampler>(obtDevice, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_FALSE);
+}
+
+GpuCullSystem::~GpuCullSystem() {
+	destroyDepthPyramid();
+	vkDestroyPipelineLayout(obtDevice.device(), cullPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(obtDevice.device(), reducePipelineLayout, nullptr);
+}
+
+void GpuCullSystem::createDescriptorSetLayouts() {
+	cullSetLayout = ObtDescriptorSetLayout::Builder(obtDevice)
+		.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.addBinding(5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.build();
+
+	reduceSetLayout = ObtDescriptorSetLayout::Builder(obtDevice)
+		.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+		.build();
+
+	cullPool = ObtDescriptorPool::Builder(obtDevice)
+		.setMaxSets(framesInFlight)
+		.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, framesInFlight)
+		.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, framesInFlight * 5)
+		.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, framesInFlight)
+		.build();
+
+	// Every level but the first reads the level before it, the first reads the frame's depth buffer
+	pyramidPool = ObtDescriptorPool::Builder(obtDevice)
+		.setMaxSets(MAX_PYRAMID_LEVELS + framesInFlight)
+		.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_PYRAMID_LEVELS + framesInFlight)
+		.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_PYRAMID_LEVELS + framesInFlight)
+		.build();
+}
+
+void GpuCullSystem::createPipelines() {
+	VkDescriptorSetLayout cullLayout = cullSetLayout->getDescriptorSetLayout();
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &cullLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 0;
+	pipelineLayoutInfo.pPushConstantRanges = nullptr;
+
+	if (vkCreatePipelineLayout(obtDevice.device(), &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline layout!");
+	}
+
+	VkDescriptorSetLayout reduceLayout = reduceSetLayout->getDescriptorSetLayout();
+	pipelineLayoutInfo.pSetLayouts = &reduceLayout;
+
+	if (vkCreatePipelineLayout(obtDevice.device(), &pipelineLayoutInfo, nullptr, &reducePipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline layout!");
+	}
+
+	cullPipeline = std::make_unique<ObtComputePipeline>(obtDevice, "res/shaders/cull.comp.spv", cullPipelineLayout);
+	reducePipeline = std::make_unique<ObtComputePipeline>(obtDevice, "res/shaders/depth_reduce.comp.spv", reducePipelineLayout);
+}
+
+void GpuCullSystem::createFrameResources() {
+	frames.resize(framesInFlight);
+	for (auto& frame : frames) {
+		frame.objects = std::make_unique<ObtGrowableBuffer>(obtDevice, sizeof(CullObject), 1);
+		frame.models = std::make_unique<ObtGrowableBuffer>(obtDevice, sizeof(DrawModel), 1);
+		frame.commands = std::make_unique<ObtBuffer>(obtDevice, sizeof(VkDrawIndexedIndirectCommand), 1, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		frame.instances = std::make_unique<ObtBuffer>(obtDevice, sizeof(uint32_t), 1, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		frame.counts = std::make_unique<ObtBuffer>(obtDevice, sizeof(uint32_t), 1, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		frame.cullData = std::make_unique<ObtBuffer>(obtDevice, sizeof(CullData), 1, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		frame.cullData->map();
+	}
+}
+
+/**
+ * Brings a frame's copy of the scene up to date, must be called once per frame with the objects
+ * collected for that frame, before cull
+ *
+ * @param changedObjects Dense indices of the objects whose bounds, model or flags changed since the
+ * frame last uploaded them
+ */
+void GpuCullSystem::updateObjects(int frameIndex, const ObtScene& scene, const std::vector<uint32_t>& changedObjects) {
+	FrameResources& frame = frames[frameIndex];
+	if (batchVersion != scene.getStructureVersion()) {
+		updateDrawBatches(scene);
+	}
+	if (frame.structureVersion != scene.getStructureVersion()) {
+		updateModels(frame, scene);
+	}
+
+	// The frame's fence has been waited on, so its object buffer can be reallocated here
+	frame.objects->reserve(scene.size());
+	ObtBuffer& objectBuffer = frame.objects->getBuffer();
+	CullObject* objects = frame.objects->data<CullObject>();
+	auto& bounds = scene.getWorldBounds();
+	auto& modelIds = scene.getModelIds();
+	auto& flags = scene.getFlags();
+	for (uint32_t i : changedObjects) {
+		objects[i] = CullObject{bounds[i], modelIds[i], flags[i], {0, 0}};
+		objectBuffer.markDirty(sizeof(CullObject), sizeof(CullObject) * i);
+	}
+	objectBuffer.flushDirty();
+	frame.objectCount = scene.size();
+}
+
+/**
+ * Gives every model a range of commands large enough for all of its objects, models without an
+ * index buffer or without objects get no batch
+ */
+void GpuCullSystem::updateDrawBatches(const ObtScene& scene) {
+	uint32_t modelCount = scene.getModelCount();
+	std::vector<uint32_t> objectCounts(modelCount, 0);
+	for (ObtScene::model_id_t modelId : scene.getModelIds()) {
+		if (modelId != ObtScene::NO_MODEL) objectCounts[modelId]++;
+	}
+
+	drawBatches.clear();
+	modelFirstCommands.assign(modelCount, 0);
+	commandCount = 0;
+	for (ObtScene::model_id_t modelId = 0; modelId < modelCount; modelId++) {
+		modelFirstCommands[modelId] = commandCount;
+		if (objectCounts[modelId] == 0 || scene.getModel(modelId)->getIndexCount() == 0) continue;
+
+		drawBatches.push_back(DrawBatch{modelId, commandCount, objectCounts[modelId]});
+		commandCount += objectCounts[modelId];
+	}
+	batchVersion = scene.getStructureVersion();
+}
+
+/**
+ * Writes the per model table the cull shader appends commands with and grows the frame's command
+ * and count buffers to the current batches
+ */
+void GpuCullSystem::updateModels(FrameResources& frame, const ObtScene& scene) {
+	uint32_t modelCount = scene.getModelCount();
+	frame.models->reserve(modelCount);
+	DrawModel* models = frame.models->data<DrawModel>();
+	for (ObtScene::model_id_t modelId = 0; modelId < modelCount; modelId++) {
+		models[modelId] = DrawModel{scene.getModel(modelId)->getIndexCount(), modelFirstCommands[modelId]};
+	}
+	frame.models->getBuffer().markDirty(sizeof(DrawModel) * modelCount, 0);
+	frame.models->getBuffer().flushDirty();
+
+	// Both buffers are rewritten by the GPU every frame, so their contents need not be kept
+	if (frame.commands->getInstanceCount() < commandCount) {
+		uint32_t capacity = grownCapacity(frame.commands->getInstanceCount(), commandCount);
+		frame.commands = std::make_unique<ObtBuffer>(obtDevice, sizeof(VkDrawIndexedIndirectCommand), capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		frame.instancesBaseGeneration += frame.instances->getGeneration() + 1;
+		frame.instances = std::make_unique<ObtBuffer>(obtDevice, sizeof(uint32_t), capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		frame.cullSetDirty = true;
+	}
+	if (frame.counts->getInstanceCount() < modelCount) {
+		uint32_t capacity = grownCapacity(frame.counts->getInstanceCount(), modelCount);
+		frame.counts = std::make_unique<ObtBuffer>(obtDevice, sizeof(uint32_t), capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		frame.cullSetDirty = true;
+	}
+	frame.structureVersion = scene.getStructureVersion();
+}
+
+void GpuCullSystem::writeCullSet(FrameResources& frame) {
+	auto cullDataInfo = frame.cullData->descriptorInfo();
+	auto objectInfo = frame.objects->descriptorInfo();
+	auto modelInfo = frame.models->descriptorInfo();
+	auto commandInfo = frame.commands->descriptorInfo();
+	auto instanceInfo = frame.instances->descriptorInfo();
+	auto countInfo = frame.counts->descriptorInfo();
+	VkDescriptorImageInfo pyramidInfo{pyramidSampler->getSampler(), pyramidView, VK_IMAGE_LAYOUT_GENERAL};
+	auto cullWriter = ObtDescriptorWriter(*cullSetLayout, *cullPool)
+		.writeBuffer(0, &cullDataInfo)
+		.writeBuffer(1, &objectInfo)
+		.writeBuffer(2, &modelInfo)
+		.writeBuffer(3, &commandInfo)
+		.writeBuffer(4, &countInfo)
+		.writeImage(5, &pyramidInfo)
+		.writeBuffer(6, &instanceInfo);
+
+	if (frame.cullSet == VK_NULL_HANDLE) {
+		if (!cullWriter.build(frame.cullSet)) {
+			throw std::runtime_error("Failed to allocate cull descriptor set!");
+		}
+	} else {
+		cullWriter.overwrite(frame.cullSet);
+	}
+
+	frame.cullSetDirty = false;
+	frame.objectsGeneration = frame.objects->getGeneration();
+	frame.modelsGeneration = frame.models->getGeneration();
+	frame.commandsGeneration = frame.commands->getGeneration();
+	frame.instancesGeneration = frame.instances->getGeneration();
+	frame.countsGeneration = frame.counts->getGeneration();
+	frame.pyramidGeneration = pyramidGeneration;
+}
+
+/**
+ * Records the cull pass, must come before the render pass that draws the batches
+ *
+ * @param extent Size of the depth buffer, the depth pyramid is recreated when it changes
+ */
+void GpuCullSystem::cull(VkCommandBuffer commandBuffer, int frameIndex, const ObtCamera& camera, VkExtent2D extent) {
+	if (extent.width != pyramidExtent.width || extent.height != pyramidExtent.height) {
+		// Other frames in flight may still sample the old pyramid
+		obtDevice.waitIdle();
+		destroyDepthPyramid();
+		createDepthPyramid(extent);
+	}
+
+	FrameResources& frame = frames[frameIndex];
+	if (frame.cullSetDirty || frame.objectsGeneration != frame.objects->getGeneration() || frame.modelsGeneration != frame.models->getGeneration() ||
+		frame.commandsGeneration != frame.commands->getGeneration() || frame.instancesGeneration != frame.instances->getGeneration() || frame.countsGeneration != frame.counts->getGeneration() || frame.pyramidGeneration != pyramidGeneration) {
+		writeCullSet(frame);
+	}
+
+	CullData cullData{};
+	cullData.planes = camera.getFrustumPlanes();
+	cullData.pyramidProjView = pyramidProjView;
+	cullData.pyramidSize = glm::vec2{static_cast<float>(pyramidExtent.width), static_cast<float>(pyramidExtent.height)};
+	cullData.objectCount = frame.objectCount;
+	cullData.occlusionEnabled = pyramidValid ? 1 : 0;
+	frame.cullData->writeToBuffer(&cullData);
+	frame.cullData->flushDirty();
+
+	// The defragmenter may have copied into a relocated count buffer earlier this frame, later
+	// compute writes are ordered after its copies by the barrier following the fill
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	vkCmdFillBuffer(commandBuffer, frame.counts->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	if (frame.objectCount > 0) {
+		cullPipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &frame.cullSet, 0, nullptr);
+		vkCmdDispatch(commandBuffer, (frame.objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	}
+
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+/**
+ * Reduces the frame's depth buffer into the depth pyramid the next frame culls against, must come
+ * after the render pass
+ *
+ * @param depthView View of the depth buffer just rendered, in depth read only layout
+ * @param projView Camera the depth buffer was rendered with
+ */
+void GpuCullSystem::buildDepthPyramid(VkCommandBuffer commandBuffer, int frameIndex, VkImageView depthView, const glm::mat4& projView) {
+	assert(pyramidImage != VK_NULL_HANDLE && "Cannot build the depth pyramid before the first cull");
+	FrameResources& frame = frames[frameIndex];
+
+	// The depth view changes with the swap chain image, the set is only used by this frame
+	VkDescriptorImageInfo depthInfo{pyramidSampler->getSampler(), depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+	VkDescriptorImageInfo levelInfo{VK_NULL_HANDLE, pyramidLevelViews[0], VK_IMAGE_LAYOUT_GENERAL};
+	ObtDescriptorWriter(*reduceSetLayout, *pyramidPool)
+		.writeImage(0, &depthInfo)
+		.writeImage(1, &levelInfo)
+		.overwrite(frame.depthSet);
+
+	// This frame's cull pass has to finish reading the pyramid before it is overwritten
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+	reducePipeline->bind(commandBuffer);
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	for (uint32_t level = 0; level < pyramidLevels; level++) {
+		VkDescriptorSet set = level == 0 ? frame.depthSet : pyramidLevelSets[level - 1];
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, reducePipelineLayout, 0, 1, &set, 0, nullptr);
+
+		uint32_t width = std::max(pyramidExtent.width >> level, 1u);
+		uint32_t height = std::max(pyramidExtent.height >> level, 1u);
+		vkCmdDispatch(commandBuffer, (width + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, (height + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, 1);
+
+		// Every level is read by the next one, the last by the next frame's cull pass
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	pyramidProjView = projView;
+	pyramidValid = true;
+}
+
+void GpuCullSystem::createDepthPyramid(VkExtent2D extent) {
+	pyramidExtent = extent;
+	pyramidLevels = 1;
+	while ((std::max(extent.width, extent.height) >> pyramidLevels) > 0) pyramidLevels++;
+	assert(pyramidLevels <= MAX_PYRAMID_LEVELS && "Depth buffer too large for the depth pyramid");
+
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent.width = extent.width;
+	imageInfo.extent.height = extent.height;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = pyramidLevels;
+	imageInfo.arrayLayers = 1;
+	imageInfo.format = VK_FORMAT_R32_SFLOAT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.flags = 0;
+
+	obtDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pyramidImage, pyramidMemory);
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = pyramidImage;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = VK_FORMAT_R32_SFLOAT;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.baseMipLevel = 0;
+	viewInfo.subresourceRange.levelCount = pyramidLevels;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount = 1;
+
+	if (vkCreateImageView(obtDevice.device(), &viewInfo, nullptr, &pyramidView) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create depth pyramid view!");
+	}
+
+	pyramidLevelViews.resize(pyramidLevels);
+	for (uint32_t level = 0; level < pyramidLevels; level++) {
+		viewInfo.subresourceRange.baseMipLevel = level;
+		viewInfo.subresourceRange.levelCount = 1;
+		if (vkCreateImageView(obtDevice.device(), &viewInfo, nullptr, &pyramidLevelViews[level]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create depth pyramid view!");
+		}
+	}
+
+	// The pyramid never leaves the general layout, only compute shaders read and write it
+	VkCommandBuffer commandBuffer = obtDevice.beginSingleTimeCommands();
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = pyramidImage;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = pyramidLevels;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	obtDevice.endSingleTimeCommands(commandBuffer);
+
+	pyramidLevelSets.resize(pyramidLevels - 1);
+	for (uint32_t level = 1; level < pyramidLevels; level++) {
+		VkDescriptorImageInfo sourceInfo{pyramidSampler->getSampler(), pyramidLevelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL};
+		VkDescriptorImageInfo levelInfo{VK_NULL_HANDLE, pyramidLevelViews[level], VK_IMAGE_LAYOUT_GENERAL};
+		bool allocated = ObtDescriptorWriter(*reduceSetLayout, *pyramidPool)
+			.writeImage(0, &sourceInfo)
+			.writeImage(1, &levelInfo)
+			.build(pyramidLevelSets[level - 1]);
+		if (!allocated) {
+			throw std::runtime_error("Failed to allocate depth pyramid descriptor set!");
+		}
+	}
+	for (auto& frame : frames) {
+		if (!pyramidPool->allocateDescriptor(reduceSetLayout->getDescriptorSetLayout(), frame.depthSet)) {
+			throw std::runtime_error("Failed to allocate depth pyramid descriptor set!");
+		}
+	}
+
+	pyramidGeneration++;
+	pyramidValid = false;
+}
+
+void GpuCullSystem::destroyDepthPyramid() {
+	if (pyramidImage == VK_NULL_HANDLE) return;
+
+	pyramidPool->resetPool();
+	pyramidLevelSets.clear();
+	for (auto& frame : frames) {
+		frame.depthSet = VK_NULL_HANDLE;
+	}
+
+	for (VkImageView view : pyramidLevelViews) {
+		vkDestroyImageView(obtDevice.device(), view, nullptr);
+	}
+	pyramidLevelViews.clear();
+	vkDestroyImageView(obtDevice.device(), pyramidView, nullptr);
+	obtDevice.destroyImage(pyramidImage, pyramidMemory);
+	pyramidView = VK_NULL_HANDLE;
+	pyramidImage = VK_NULL_HANDLE;
+}
+
+}
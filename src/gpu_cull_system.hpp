@@ -0,0 +1,129 @@
+#pragma once
+
+#include "obt_device.hpp"
+#include "obt_buffer.hpp"
+#include "obt_growable_buffer.hpp"
+#include "obt_descriptors.hpp"
+#include "obt_pipeline.hpp"
+#include "obt_image.hpp"
+#include "obt_scene.hpp"
+#include "obt_camera.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace obt {
+
+// Culls the scene on the GPU. A compute shader tests every object's bounding sphere against the
+// camera frustum and against a depth pyramid built from the previous frame, and appends the
+// survivors as indirect draw commands. Every model owns a contiguous range of commands with its
+// own draw count, so the whole scene is drawn with one indirect count draw per model and the CPU
+// only ever touches objects that changed.
+//
+// Occlusion is tested with the depth and camera of the previous frame, an object that comes into
+// view from behind an occluder appears one frame late.
+class GpuCullSystem {
+	public:
+		static constexpr uint32_t CULL_GROUP_SIZE = 64;
+		static constexpr uint32_t REDUCE_GROUP_SIZE = 8;
+		static constexpr uint32_t MAX_PYRAMID_LEVELS = 16;
+
+		struct DrawBatch {
+			ObtScene::model_id_t modelId;
+			uint32_t firstCommand;
+			uint32_t maxDrawCount;
+		};
+
+		GpuCullSystem(ObtDevice& device, uint32_t framesInFlight);
+		~GpuCullSystem();
+
+		GpuCullSystem(const GpuCullSystem&) = delete;
+		GpuCullSystem &operator=(const GpuCullSystem&) = delete;
+
+		void updateObjects(int frameIndex, const ObtScene& scene, const std::vector<uint32_t>& changedObjects);
+		void cull(VkCommandBuffer commandBuffer, int frameIndex, const ObtCamera& camera, VkExtent2D extent);
+		void buildDepthPyramid(VkCommandBuffer commandBuffer, int frameIndex, VkImageView depthView, const glm::mat4& projView);
+
+		// Batches match the command and count buffers of the frame last passed to updateObjects
+		const std::vector<DrawBatch>& getDrawBatches() const { return drawBatches; }
+		VkBuffer getCommandBuffer(int frameIndex) const { return frames[frameIndex].commands->getBuffer(); }
+		VkBuffer getCountBuffer(int frameIndex) const { return frames[frameIndex].counts->getBuffer(); }
+
+		// Object index of every instance the commands draw, read by the vertex shader. The generation
+		// changes whenever descriptor sets referencing the buffer need to be rewritten.
+		VkDescriptorBufferInfo instanceDescriptorInfo(int frameIndex) { return frames[frameIndex].instances->descriptorInfo(); }
+		uint32_t getInstanceGeneration(int frameIndex) const { return frames[frameIndex].instancesBaseGeneration + frames[frameIndex].instances->getGeneration(); }
+
+	private:
+		struct FrameResources {
+			std::unique_ptr<ObtGrowableBuffer> objects;
+			std::unique_ptr<ObtGrowableBuffer> models;
+			std::unique_ptr<ObtBuffer> commands;
+			std::unique_ptr<ObtBuffer> instances;
+			std::unique_ptr<ObtBuffer> counts;
+			std::unique_ptr<ObtBuffer> cullData;
+			VkDescriptorSet cullSet = VK_NULL_HANDLE;
+			VkDescriptorSet depthSet = VK_NULL_HANDLE;
+			uint32_t objectCount = 0;
+			uint32_t structureVersion = ~0u;
+			// Keeps the instance generation increasing when the buffer is replaced
+			uint32_t instancesBaseGeneration = 0;
+
+			// Resources the cull set was last written with, it is rewritten when any of them changed
+			bool cullSetDirty = true;
+			uint32_t objectsGeneration = 0;
+			uint32_t modelsGeneration = 0;
+			uint32_t commandsGeneration = 0;
+			uint32_t instancesGeneration = 0;
+			uint32_t countsGeneration = 0;
+			uint32_t pyramidGeneration = 0;
+		};
+
+		void createDescriptorSetLayouts();
+		void createPipelines();
+		void createFrameResources();
+		void updateDrawBatches(const ObtScene& scene);
+		void updateModels(FrameResources& frame, const ObtScene& scene);
+		void writeCullSet(FrameResources& frame);
+		void createDepthPyramid(VkExtent2D extent);
+		void destroyDepthPyramid();
+
+		ObtDevice& obtDevice;
+		uint32_t framesInFlight;
+
+		std::unique_ptr<ObtDescriptorSetLayout> cullSetLayout;
+		std::unique_ptr<ObtDescriptorSetLayout> reduceSetLayout;
+		std::unique_ptr<ObtDescriptorPool> cullPool;
+		std::unique_ptr<ObtDescriptorPool> pyramidPool;
+		VkPipelineLayout cullPipelineLayout;
+		VkPipelineLayout reducePipelineLayout;
+		std::unique_ptr<ObtComputePipeline> cullPipeline;
+		std::unique_ptr<ObtComputePipeline> reducePipeline;
+
+		std::vector<FrameResources> frames;
+
+		// Per model command ranges, recomputed whenever the scene's structure version changes
+		std::vector<DrawBatch> drawBatches;
+		std::vector<uint32_t> modelFirstCommands;
+		uint32_t commandCount = 0;
+		uint32_t batchVersion = ~0u;
+
+		// Farthest depth pyramid of the last rendered frame, level 0 has the size of the depth buffer
+		std::unique_ptr<ObtSampler> pyramidSampler;
+		VkImage pyramidImage = VK_NULL_HANDLE;
+		ObtAllocation pyramidMemory{};
+		VkImageView pyramidView = VK_NULL_HANDLE;
+		std::vector<VkImageView> pyramidLevelViews;
+		std::vector<VkDescriptorSet> pyramidLevelSets;
+		VkExtent2D pyramidExtent{0, 0};
+		uint32_t pyramidLevels = 0;
+		uint32_t pyramidGeneration = 0;
+		glm::mat4 pyramidProjView{1.f};
+		bool pyramidValid = false;
+};
+
+}
@@ -0,0 +1,502 @@
+#include "obt_allocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace obt {
+
+static uint32_t findLastSet(uint64_t value) { return 63 - __builtin_clzll(value); }
+static uint32_t findFirstSet(uint64_t value) { return __builtin_ctzll(value); }
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static VkDeviceSize alignDown(VkDeviceSize value, VkDeviceSize alignment) {
+	return value / alignment * alignment;
+}
+
+ObtTlsf::ObtTlsf(VkDeviceSize size) : size{size} {
+	for (auto& heads : freeHeads) {
+		std::fill(std::begin(heads), std::end(heads), INVALID_NODE);
+	}
+	insertFree(createNode(0, size));
+}
+
+void ObtTlsf::mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl) {
+	if (size < SL_COUNT) {
+		fl = 0;
+		sl = static_cast<uint32_t>(size);
+	} else {
+		uint32_t msb = findLastSet(size);
+		sl = static_cast<uint32_t>(size >> (msb - SL_LOG2)) & (SL_COUNT - 1);
+		fl = msb - SL_LOG2 + 1;
+	}
+}
+
+// Rounds the size up to the next list boundary so any node found in that list is large enough
+void ObtTlsf::mappingSearch(VkDeviceSize size, uint32_t& fl, uint32_t& sl) {
+	if (size >= SL_COUNT) {
+		size += (VkDeviceSize{1} << (findLastSet(size) - SL_LOG2)) - 1;
+	}
+	mapping(size, fl, sl);
+}
+
+uint32_t ObtTlsf::createNode(VkDeviceSize offset, VkDeviceSize size) {
+	uint32_t index;
+	if (!unusedNodes.empty()) {
+		index = unusedNodes.back();
+		unusedNodes.pop_back();
+		nodes[index] = Node{};
+	} else {
+		index = static_cast<uint32_t>(nodes.size());
+		nodes.emplace_back();
+	}
+	nodes[index].offset = offset;
+	nodes[index].size = size;
+	return index;
+}
+
+void ObtTlsf::releaseNode(uint32_t node) {
+	unusedNodes.push_back(node);
+}
+
+void ObtTlsf::insertFree(uint32_t node) {
+	uint32_t fl, sl;
+	mapping(nodes[node].size, fl, sl);
+
+	nodes[node].free = true;
+	nodes[node].prevFree = INVALID_NODE;
+	nodes[node].nextFree = freeHeads[fl][sl];
+	if (freeHeads[fl][sl] != INVALID_NODE) nodes[freeHeads[fl][sl]].prevFree = node;
+	freeHeads[fl][sl] = node;
+
+	flBitmap |= uint64_t{1} << fl;
+	slBitmap[fl] |= 1u << sl;
+}
+
+void ObtTlsf::removeFree(uint32_t node) {
+	uint32_t fl, sl;
+	mapping(nodes[node].size, fl, sl);
+
+	Node& n = nodes[node];
+	if (n.prevFree != INVALID_NODE) nodes[n.prevFree].nextFree = n.nextFree;
+	if (n.nextFree != INVALID_NODE) nodes[n.nextFree].prevFree = n.prevFree;
+	if (freeHeads[fl][sl] == node) {
+		freeHeads[fl][sl] = n.nextFree;
+		if (freeHeads[fl][sl] == INVALID_NODE) {
+			slBitmap[fl] &= ~(1u << sl);
+			if (slBitmap[fl] == 0) flBitmap &= ~(uint64_t{1} << fl);
+		}
+	}
+	n.free = false;
+	n.prevFree = INVALID_NODE;
+	n.nextFree = INVALID_NODE;
+}
+
+// Splits the node so it keeps the first size bytes, returns the node holding the remainder
+uint32_t ObtTlsf::split(uint32_t node, VkDeviceSize size) {
+	uint32_t remainder = createNode(nodes[node].offset + size, nodes[node].size - size);
+	nodes[remainder].prevPhysical = node;
+	nodes[remainder].nextPhysical = nodes[node].nextPhysical;
+	if (nodes[node].nextPhysical != INVALID_NODE) nodes[nodes[node].nextPhysical].prevPhysical = remainder;
+	nodes[node].nextPhysical = remainder;
+	nodes[node].size = size;
+	return remainder;
+}
+
+bool ObtTlsf::findSuitable(uint32_t& fl, uint32_t& sl) const {
+	if (fl >= FL_COUNT) return false;
+
+	uint32_t slMap = slBitmap[fl] & (~0u << sl);
+	if (slMap == 0) {
+		if (fl + 1 >= FL_COUNT) return false;
+		uint64_t flMap = flBitmap & (~uint64_t{0} << (fl + 1));
+		if (flMap == 0) return false;
+		fl = findFirstSet(flMap);
+		slMap = slBitmap[fl];
+	}
+	sl = findFirstSet(slMap);
+	return true;
+}
+
+/**
+ * Finds a free range of at least size bytes whose offset is a multiple of alignment
+ *
+ * @param size Size of the range in bytes
+ * @param alignment Required alignment of the returned offset
+ * @param offset Receives the offset of the range
+ * @param node Receives the handle that must be passed to free
+ *
+ * @return false if no free range is large enough
+ */
+bool ObtTlsf::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset, uint32_t& node) {
+	assert(size > 0 && "Cannot allocate an empty range");
+	alignment = std::max<VkDeviceSize>(alignment, 1);
+
+	uint32_t fl, sl;
+	mappingSearch(size + alignment - 1, fl, sl);
+	if (!findSuitable(fl, sl)) return false;
+
+	node = freeHeads[fl][sl];
+	removeFree(node);
+
+	VkDeviceSize alignedOffset = alignUp(nodes[node].offset, alignment);
+	VkDeviceSize padding = alignedOffset - nodes[node].offset;
+	if (padding > 0) {
+		uint32_t aligned = split(node, padding);
+		insertFree(node);
+		node = aligned;
+	}
+
+	if (nodes[node].size > size) {
+		insertFree(split(node, size));
+	}
+
+	offset = nodes[node].offset;
+	usedBytes += nodes[node].size;
+	allocationCount++;
+	return true;
+}
+
+void ObtTlsf::free(uint32_t node) {
+	assert(!nodes[node].free && "Double free of tlsf node");
+	usedBytes -= nodes[node].size;
+	allocationCount--;
+
+	uint32_t prev = nodes[node].prevPhysical;
+	if (prev != INVALID_NODE && nodes[prev].free) {
+		removeFree(prev);
+		nodes[prev].size += nodes[node].size;
+		nodes[prev].nextPhysical = nodes[node].nextPhysical;
+		if (nodes[node].nextPhysical != INVALID_NODE) nodes[nodes[node].nextPhysical].prevPhysical = prev;
+		releaseNode(node);
+		node = prev;
+	}
+
+	uint32_t next = nodes[node].nextPhysical;
+	if (next != INVALID_NODE && nodes[next].free) {
+		removeFree(next);
+		nodes[node].size += nodes[next].size;
+		nodes[node].nextPhysical = nodes[next].nextPhysical;
+		if (nodes[next].nextPhysical != INVALID_NODE) nodes[nodes[next].nextPhysical].prevPhysical = node;
+		releaseNode(next);
+	}
+
+	insertFree(node);
+}
+
+VkDeviceSize ObtTlsf::getLargestFreeRange() const {
+	if (flBitmap == 0) return 0;
+
+	uint32_t fl = findLastSet(flBitmap);
+	uint32_t sl = findLastSet(slBitmap[fl]);
+	VkDeviceSize largest = 0;
+	for (uint32_t node = freeHeads[fl][sl]; node != INVALID_NODE; node = nodes[node].nextFree) {
+		largest = std::max(largest, nodes[node].size);
+	}
+	return largest;
+}
+
+ObtAllocator::ObtAllocator(VkDevice device, VkPhysicalDevice physicalDevice, const VkPhysicalDeviceProperties& properties)
+	: device{device}, bufferImageGranularity{properties.limits.bufferImageGranularity}, nonCoherentAtomSize{properties.limits.nonCoherentAtomSize} {
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	pools.resize(memoryProperties.memoryTypeCount * 2);
+	heapReservedBytes.resize(memoryProperties.memoryHeapCount);
+	heapCategoryBytes.resize(memoryProperties.memoryHeapCount);
+}
+
+ObtAllocator::~ObtAllocator() {
+	for (auto& pool : pools) {
+		for (auto& block : pool) {
+			vkFreeMemory(device, block->memory, nullptr);
+		}
+	}
+}
+
+uint32_t ObtAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+// Small heaps (e.g. the 256MB host visible device local heap) get proportionally smaller blocks
+VkDeviceSize ObtAllocator::preferredBlockSize(uint32_t memoryTypeIndex) const {
+	VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+	return heapSize <= 1024ull * 1024 * 1024 ? std::min(DEFAULT_BLOCK_SIZE, alignUp(heapSize / 8, 32)) : DEFAULT_BLOCK_SIZE;
+}
+
+// Linear (buffers) and optimal (images) resources only share blocks when bufferImageGranularity
+// can't make them alias on the same page
+std::vector<std::unique_ptr<ObtMemoryBlock>>& ObtAllocator::getPool(uint32_t memoryTypeIndex, bool linear) {
+	bool separate = bufferImageGranularity > 1 && !linear;
+	return pools[memoryTypeIndex * 2 + (separate ? 1 : 0)];
+}
+
+VkDeviceMemory ObtAllocator::allocateMemory(uint32_t memoryTypeIndex, VkDeviceSize size, void** mapped) {
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+		return VK_NULL_HANDLE;
+	}
+
+	heapReservedBytes[heapIndex(memoryTypeIndex)] += size;
+
+	*mapped = nullptr;
+	if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+			freeMemory(memory, memoryTypeIndex, size);
+			throw std::runtime_error("failed to map device memory!");
+		}
+	}
+
+	return memory;
+}
+
+void ObtAllocator::freeMemory(VkDeviceMemory memory, uint32_t memoryTypeIndex, VkDeviceSize size) {
+	vkFreeMemory(device, memory, nullptr);
+	heapReservedBytes[heapIndex(memoryTypeIndex)] -= size;
+}
+
+ObtMemoryBlock* ObtAllocator::createBlock(uint32_t memoryTypeIndex, bool linear, VkDeviceSize minSize) {
+	VkDeviceSize blockSize = std::max(preferredBlockSize(memoryTypeIndex), minSize);
+
+	void* mapped;
+	VkDeviceMemory memory = allocateMemory(memoryTypeIndex, blockSize, &mapped);
+	while (memory == VK_NULL_HANDLE && blockSize / 2 >= minSize) {
+		blockSize /= 2;
+		memory = allocateMemory(memoryTypeIndex, blockSize, &mapped);
+	}
+	if (memory == VK_NULL_HANDLE) return nullptr;
+
+	auto& pool = getPool(memoryTypeIndex, linear);
+	pool.push_back(std::unique_ptr<ObtMemoryBlock>(new ObtMemoryBlock{memory, blockSize, mapped, memoryTypeIndex, linear, ObtTlsf{blockSize}}));
+	return pool.back().get();
+}
+
+/**
+ * Sub-allocates memory for a resource from a shared block, or a dedicated allocation for large resources
+ *
+ * @param requirements Memory requirements of the buffer or image
+ * @param properties Required memory property flags
+ * @param linear True for buffers and linear images, false for optimal tiling images
+ * @param category What the memory is used for, only used for budget reporting
+ *
+ * @return The allocation, bind the resource at allocation.memory + allocation.offset
+ */
+ObtAllocation ObtAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear, ObtMemoryCategory category) {
+	std::lock_guard<std::mutex> lock{mutex};
+
+	ObtAllocation allocation{};
+	allocation.category = category;
+	allocation.memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
+	allocation.memoryPropertyFlags = memoryProperties.memoryTypes[allocation.memoryTypeIndex].propertyFlags;
+
+	VkDeviceSize alignment = requirements.alignment;
+	VkDeviceSize size = requirements.size;
+	bool nonCoherent = (allocation.memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(allocation.memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	if (nonCoherent) {
+		// Flushes are widened to the atom size, so neighbours must never share an atom
+		alignment = std::max(alignment, nonCoherentAtomSize);
+		size = alignUp(size, nonCoherentAtomSize);
+	}
+
+	if (size > preferredBlockSize(allocation.memoryTypeIndex) / 2) {
+		allocation.memory = allocateMemory(allocation.memoryTypeIndex, size, &allocation.mapped);
+		if (allocation.memory == VK_NULL_HANDLE) {
+			throw std::runtime_error("failed to allocate device memory!");
+		}
+		allocation.size = size;
+		dedicatedAllocationCount++;
+		dedicatedBytes += size;
+		heapCategoryBytes[heapIndex(allocation.memoryTypeIndex)][static_cast<uint32_t>(category)] += size;
+		return allocation;
+	}
+
+	ObtMemoryBlock* block = nullptr;
+	for (auto& candidate : getPool(allocation.memoryTypeIndex, linear)) {
+		if (candidate->evacuating) continue;
+		if (candidate->tlsf.allocate(size, alignment, allocation.offset, allocation.node)) {
+			block = candidate.get();
+			break;
+		}
+	}
+
+	if (block == nullptr) {
+		block = createBlock(allocation.memoryTypeIndex, linear, size);
+		if (block == nullptr || !block->tlsf.allocate(size, alignment, allocation.offset, allocation.node)) {
+			throw std::runtime_error("failed to allocate device memory!");
+		}
+	}
+
+	allocation.memory = block->memory;
+	allocation.size = size;
+	allocation.block = block;
+	allocation.mapped = block->mapped ? static_cast<char*>(block->mapped) + allocation.offset : nullptr;
+	heapCategoryBytes[heapIndex(allocation.memoryTypeIndex)][static_cast<uint32_t>(category)] += size;
+	return allocation;
+}
+
+void ObtAllocator::free(ObtAllocation& allocation) {
+	if (allocation.memory == VK_NULL_HANDLE) return;
+
+	std::lock_guard<std::mutex> lock{mutex};
+
+	heapCategoryBytes[heapIndex(allocation.memoryTypeIndex)][static_cast<uint32_t>(allocation.category)] -= allocation.size;
+
+	if (allocation.block == nullptr) {
+		freeMemory(allocation.memory, allocation.memoryTypeIndex, allocation.size);
+		dedicatedAllocationCount--;
+		dedicatedBytes -= allocation.size;
+	} else {
+		ObtMemoryBlock* block = allocation.block;
+		block->tlsf.free(allocation.node);
+
+		// Keep one empty block per pool around so alloc/free churn doesn't hit the driver
+		auto& pool = getPool(block->memoryTypeIndex, block->linear);
+		if (block->tlsf.isEmpty() && pool.size() > 1) {
+			auto it = std::find_if(pool.begin(), pool.end(), [&](const auto& b) { return b.get() == block; });
+			freeMemory(block->memory, block->memoryTypeIndex, block->size);
+			pool.erase(it);
+		}
+	}
+
+	allocation = ObtAllocation{};
+}
+
+/**
+ * Builds a flush/invalidate range for part of an allocation, widened to nonCoherentAtomSize
+ *
+ * @param allocation The host visible allocation
+ * @param size Size of the range, VK_WHOLE_SIZE for the rest of the allocation
+ * @param offset Offset of the range from the start of the allocation
+ */
+VkMappedMemoryRange ObtAllocator::mappedRange(const ObtAllocation& allocation, VkDeviceSize size, VkDeviceSize offset) const {
+	if (size == VK_WHOLE_SIZE) size = allocation.size - offset;
+
+	VkDeviceSize memorySize = allocation.block ? allocation.block->size : allocation.size;
+	VkDeviceSize begin = alignDown(allocation.offset + offset, nonCoherentAtomSize);
+	VkDeviceSize end = alignUp(allocation.offset + offset + size, nonCoherentAtomSize);
+
+	VkMappedMemoryRange range{};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = allocation.memory;
+	range.offset = begin;
+	range.size = end >= memorySize ? VK_WHOLE_SIZE : end - begin;
+	return range;
+}
+
+ObtAllocator::Stats ObtAllocator::getStats() {
+	std::lock_guard<std::mutex> lock{mutex};
+
+	Stats stats{};
+	VkDeviceSize freeBytes = 0;
+	VkDeviceSize largestFreeBytes = 0;
+	for (auto& pool : pools) {
+		for (auto& block : pool) {
+			VkDeviceSize largestFreeRange = block->tlsf.getLargestFreeRange();
+			stats.blockCount++;
+			stats.allocationCount += block->tlsf.getAllocationCount();
+			stats.blockBytes += block->size;
+			stats.usedBytes += block->tlsf.getUsedBytes();
+			stats.largestFreeRange = std::max(stats.largestFreeRange, largestFreeRange);
+
+			// An empty block is one free range, it says nothing about how splintered the used ones are
+			if (block->tlsf.isEmpty()) continue;
+			freeBytes += block->size - block->tlsf.getUsedBytes();
+			largestFreeBytes += largestFreeRange;
+		}
+	}
+	stats.dedicatedAllocationCount = dedicatedAllocationCount;
+	stats.dedicatedBytes = dedicatedBytes;
+
+	// Mean of each block's 1 - largest free range / free bytes, weighted by the block's free bytes.
+	// 0 when every block's free memory is one contiguous range, approaching 1 as it splinters.
+	stats.fragmentation = freeBytes > 0 ? 1.f - static_cast<float>(largestFreeBytes) / static_cast<float>(freeBytes) : 0.f;
+	return stats;
+}
+
+/**
+ * Marks sparsely used device local blocks so new allocations avoid them and their contents can be
+ * moved elsewhere, the fullest block of each pool is never marked
+ *
+ * @param maxBlockUsage Blocks whose used fraction is below this are marked
+ *
+ * @return Number of blocks marked
+ */
+uint32_t ObtAllocator::beginDefragmentation(float maxBlockUsage) {
+	std::lock_guard<std::mutex> lock{mutex};
+
+	uint32_t marked = 0;
+	for (auto& pool : pools) {
+		if (pool.size() < 2) continue;
+
+		VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[pool[0]->memoryTypeIndex].propertyFlags;
+		if (!(flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) || (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) continue;
+
+		auto usage = [](const std::unique_ptr<ObtMemoryBlock>& block) {
+			return static_cast<float>(block->tlsf.getUsedBytes()) / static_cast<float>(block->size);
+		};
+		auto fullest = std::max_element(pool.begin(), pool.end(), [&](const auto& a, const auto& b) { return usage(a) < usage(b); });
+
+		for (auto it = pool.begin(); it != pool.end(); ++it) {
+			if (it != fullest && !(*it)->tlsf.isEmpty() && usage(*it) < maxBlockUsage) {
+				(*it)->evacuating = true;
+				marked++;
+			}
+		}
+	}
+	return marked;
+}
+
+void ObtAllocator::endDefragmentation() {
+	std::lock_guard<std::mutex> lock{mutex};
+
+	for (auto& pool : pools) {
+		for (auto& block : pool) {
+			block->evacuating = false;
+		}
+	}
+}
+
+/**
+ * Per heap totals of what the allocator reserved from the driver and what it handed out by category
+ *
+ * @note budget and usage default to the heap size and reserved bytes, ObtDevice replaces them
+ * with the driver's numbers when VK_EXT_memory_budget is available
+ */
+std::vector<ObtAllocator::HeapBudget> ObtAllocator::getHeapBudgets() {
+	std::lock_guard<std::mutex> lock{mutex};
+
+	std::vector<HeapBudget> budgets(memoryProperties.memoryHeapCount);
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+		budgets[i].size = memoryProperties.memoryHeaps[i].size;
+		budgets[i].flags = memoryProperties.memoryHeaps[i].flags;
+		budgets[i].budget = budgets[i].size;
+		budgets[i].usage = heapReservedBytes[i];
+		budgets[i].reservedBytes = heapReservedBytes[i];
+		budgets[i].categoryBytes = heapCategoryBytes[i];
+	}
+	return budgets;
+}
+
+const char* ObtAllocator::categoryName(ObtMemoryCategory category) {
+	switch (category) {
+		case ObtMemoryCategory::Geometry: return "geometry";
+		case ObtMemoryCategory::Texture: return "textures";
+		case ObtMemoryCategory::Attachment: return "attachments";
+		case ObtMemoryCategory::Staging: return "staging";
+		default: return "other";
+	}
+}
+
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace obt {
+
+// Two-level segregated fit sub-allocator, manages offsets inside a range and never touches memory
+class ObtTlsf {
+	public:
+		static constexpr uint32_t INVALID_NODE = ~0u;
+
+		ObtTlsf(VkDeviceSize size);
+
+		bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset, uint32_t& node);
+		void free(uint32_t node);
+
+		VkDeviceSize getSize() const { return size; }
+		VkDeviceSize getUsedBytes() const { return usedBytes; }
+		uint32_t getAllocationCount() const { return allocationCount; }
+		VkDeviceSize getLargestFreeRange() const;
+		bool isEmpty() const { return allocationCount == 0; }
+
+	private:
+		static constexpr uint32_t SL_LOG2 = 5;
+		static constexpr uint32_t SL_COUNT = 1u << SL_LOG2;
+		static constexpr uint32_t FL_COUNT = 64 - SL_LOG2 + 1;
+
+		struct Node {
+			VkDeviceSize offset;
+			VkDeviceSize size;
+			uint32_t prevPhysical = INVALID_NODE;
+			uint32_t nextPhysical = INVALID_NODE;
+			uint32_t prevFree = INVALID_NODE;
+			uint32_t nextFree = INVALID_NODE;
+			bool free = false;
+		};
+
+		static void mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl);
+		static void mappingSearch(VkDeviceSize size, uint32_t& fl, uint32_t& sl);
+
+		uint32_t createNode(VkDeviceSize offset, VkDeviceSize size);
+		void releaseNode(uint32_t node);
+		void insertFree(uint32_t node);
+		void removeFree(uint32_t node);
+		uint32_t split(uint32_t node, VkDeviceSize size);
+		bool findSuitable(uint32_t& fl, uint32_t& sl) const;
+
+		VkDeviceSize size;
+		VkDeviceSize usedBytes = 0;
+		uint32_t allocationCount = 0;
+
+		uint64_t flBitmap = 0;
+		uint32_t slBitmap[FL_COUNT]{};
+		uint32_t freeHeads[FL_COUNT][SL_COUNT];
+
+		std::vector<Node> nodes;
+		std::vector<uint32_t> unusedNodes;
+};
+
+enum class ObtMemoryCategory : uint32_t {
+	Geometry,
+	Texture,
+	Attachment,
+	Staging,
+	Other,
+	Count
+};
+
+struct ObtMemoryBlock {
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	void* mapped;
+	uint32_t memoryTypeIndex;
+	bool linear;
+	ObtTlsf tlsf;
+	bool evacuating = false;
+};
+
+struct ObtAllocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	void* mapped = nullptr;
+	uint32_t memoryTypeIndex = 0;
+	VkMemoryPropertyFlags memoryPropertyFlags = 0;
+	ObtMemoryCategory category = ObtMemoryCategory::Other;
+	ObtMemoryBlock* block = nullptr;
+	uint32_t node = ObtTlsf::INVALID_NODE;
+};
+
+// Handles left behind by a relocation, destroyed once no frame in flight can still use them
+struct ObtRetiredResource {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkImage image = VK_NULL_HANDLE;
+	VkImageView imageView = VK_NULL_HANDLE;
+	ObtAllocation allocation{};
+};
+
+// Implemented by resources whose memory the defragmenter is allowed to move
+class ObtRelocatable {
+	public:
+		virtual ~ObtRelocatable() = default;
+
+		virtual const ObtAllocation& getAllocation() const = 0;
+		virtual void relocate(VkCommandBuffer commandBuffer, ObtRetiredResource& retired) = 0;
+};
+
+class ObtAllocator {
+	public:
+		static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+		static constexpr uint32_t CATEGORY_COUNT = static_cast<uint32_t>(ObtMemoryCategory::Count);
+
+		struct Stats {
+			uint32_t blockCount = 0;
+			uint32_t allocationCount = 0;
+			uint32_t dedicatedAllocationCount = 0;
+			VkDeviceSize blockBytes = 0;
+			VkDeviceSize usedBytes = 0;
+			VkDeviceSize dedicatedBytes = 0;
+			VkDeviceSize largestFreeRange = 0;
+			float fragmentation = 0.f;
+		};
+
+		struct HeapBudget {
+			VkDeviceSize size = 0;
+			VkMemoryHeapFlags flags = 0;
+			VkDeviceSize budget = 0;
+			VkDeviceSize usage = 0;
+			VkDeviceSize reservedBytes = 0;
+			std::array<VkDeviceSize, CATEGORY_COUNT> categoryBytes{};
+		};
+
+		ObtAllocator(VkDevice device, VkPhysicalDevice physicalDevice, const VkPhysicalDeviceProperties& properties);
+		~ObtAllocator();
+
+		ObtAllocator(const ObtAllocator&) = delete;
+		ObtAllocator &operator=(const ObtAllocator&) = delete;
+
+		ObtAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear, ObtMemoryCategory category = ObtMemoryCategory::Other);
+		void free(ObtAllocation& allocation);
+
+		VkMappedMemoryRange mappedRange(const ObtAllocation& allocation, VkDeviceSize size, VkDeviceSize offset) const;
+		Stats getStats();
+
+		uint32_t beginDefragmentation(float maxBlockUsage);
+		void endDefragmentation();
+		bool isEvacuating(const ObtAllocation& allocation) const { return allocation.block != nullptr && allocation.block->evacuating; }
+		std::vector<HeapBudget> getHeapBudgets();
+
+		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+		static const char* categoryName(ObtMemoryCategory category);
+
+	private:
+		VkDeviceSize preferredBlockSize(uint32_t memoryTypeIndex) const;
+		std::vector<std::unique_ptr<ObtMemoryBlock>>& getPool(uint32_t memoryTypeIndex, bool linear);
+		ObtMemoryBlock* createBlock(uint32_t memoryTypeIndex, bool linear, VkDeviceSize minSize);
+		VkDeviceMemory allocateMemory(uint32_t memoryTypeIndex, VkDeviceSize size, void** mapped);
+		void freeMemory(VkDeviceMemory memory, uint32_t memoryTypeIndex, VkDeviceSize size);
+		uint32_t heapIndex(uint32_t memoryTypeIndex) const { return memoryProperties.memoryTypes[memoryTypeIndex].heapIndex; }
+
+		VkDevice device;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		VkDeviceSize bufferImageGranularity;
+		VkDeviceSize nonCoherentAtomSize;
+
+		std::vector<std::vector<std::unique_ptr<ObtMemoryBlock>>> pools;
+		uint32_t dedicatedAllocationCount = 0;
+		VkDeviceSize dedicatedBytes = 0;
+
+		std::vector<VkDeviceSize> heapReservedBytes;
+		std::vector<std::array<VkDeviceSize, CATEGORY_COUNT>> heapCategoryBytes;
+
+		std::mutex mutex;
+};
+
+}
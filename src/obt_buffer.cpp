@@ -6,8 +6,10 @@
  */
 
 #include "obt_buffer.hpp"
+#include "obt_stream_copy.hpp"
 
 // std
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 
@@ -33,44 +35,58 @@ ObtBuffer::ObtBuffer(ObtDevice &device, VkDeviceSize instanceSize, uint32_t inst
 	: obtDevice{device}, instanceSize{instanceSize}, instanceCount{instanceCount}, usageFlags{usageFlags}, memoryPropertyFlags{memoryPropertyFlags} {
 	alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
 	bufferSize = alignmentSize * instanceCount;
-	device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+
+	// Device local buffers are never mapped, so the defragmenter can move them with a GPU copy
+	bool relocatable = !(memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	if (relocatable) {
+		this->usageFlags |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	}
+
+	device.createBuffer(bufferSize, this->usageFlags, memoryPropertyFlags, buffer, allocation);
+	if (relocatable) device.registerRelocatable(this);
 }
 
 ObtBuffer::~ObtBuffer() {
+	obtDevice.unregisterRelocatable(this);
 	unmap();
-	vkDestroyBuffer(obtDevice.device(), buffer, nullptr);
-	vkFreeMemory(obtDevice.device(), memory, nullptr);
+	obtDevice.destroyBuffer(buffer, allocation);
 }
 
 /**
  * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
  *
+ * @note Host visible memory is persistently mapped by the allocator, this only exposes the range
+ *
  * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
  * buffer range.
  * @param offset (Optional) Byte offset from beginning
  *
  * @return VkResult of the buffer mapping call
  */
-VkResult ObtBuffer::map(VkDeviceSize size, VkDeviceSize offset) {
-	assert(buffer && memory && "Called map on buffer before create");
-	return vkMapMemory(obtDevice.device(), memory, offset, size, 0, &mapped);
+VkResult ObtBuffer::map([[maybe_unused]] VkDeviceSize size, VkDeviceSize offset) {
+	assert(buffer && allocation.memory && "Called map on buffer before create");
+	assert(offset <= bufferSize && (size == VK_WHOLE_SIZE || size <= bufferSize - offset) && "Mapped range exceeds the buffer");
+	if (allocation.mapped == nullptr) {
+		return VK_ERROR_MEMORY_MAP_FAILED;
+	}
+	mapped = static_cast<char*>(allocation.mapped) + offset;
+	return VK_SUCCESS;
 }
 
 /**
  * Unmap a mapped memory range
  *
- * @note Does not return a result as vkUnmapMemory can't fail
+ * @note The underlying memory block stays mapped until it is freed
  */
 void ObtBuffer::unmap() {
-	if (mapped) {
-		vkUnmapMemory(obtDevice.device(), memory);
-		mapped = nullptr;
-	}
+	mapped = nullptr;
 }
 
 /**
  * Copies the specified data to the mapped buffer. Default value writes whole buffer range
  *
+ * @note Uncached (write-combined) memory is written with non-temporal stores
+ *
  * @param data Pointer to the data to copy
  * @param size (Optional) Size of the data to copy. Pass VK_WHOLE_SIZE to flush the complete buffer
  * range.
@@ -80,13 +96,15 @@ void ObtBuffer::unmap() {
 void ObtBuffer::writeToBuffer(void* data, VkDeviceSize size, VkDeviceSize offset) {
 	assert(mapped && "Cannot copy to unmapped buffer");
 
+	auto copy = isWriteCombined() ? streamCopy : [](void* dst, const void* src, size_t size) { memcpy(dst, src, size); };
 	if (size == VK_WHOLE_SIZE) {
-		memcpy(mapped, data, bufferSize);
+		copy(mapped, data, bufferSize);
 	} else {
 		char* memOffset = (char*)mapped;
 		memOffset += offset;
-		memcpy(memOffset, data, size);
+		copy(memOffset, data, size);
 	}
+	markDirty(size, getMappedOffset() + offset);
 }
 
 /**
@@ -101,11 +119,8 @@ void ObtBuffer::writeToBuffer(void* data, VkDeviceSize size, VkDeviceSize offset
  * @return VkResult of the flush call
  */
 VkResult ObtBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-	VkMappedMemoryRange mappedRange = {};
-	mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-	mappedRange.memory = memory;
-	mappedRange.offset = offset;
-	mappedRange.size = size;
+	if (isCoherent()) return VK_SUCCESS;
+	VkMappedMemoryRange mappedRange = obtDevice.getAllocator().mappedRange(allocation, size, offset);
 	return vkFlushMappedMemoryRanges(obtDevice.device(), 1, &mappedRange);
 }
 
@@ -121,14 +136,80 @@ VkResult ObtBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
  * @return VkResult of the invalidate call
  */
 VkResult ObtBuffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-	VkMappedMemoryRange mappedRange = {};
-	mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-	mappedRange.memory = memory;
-	mappedRange.offset = offset;
-	mappedRange.size = size;
+	if (isCoherent()) return VK_SUCCESS;
+	VkMappedMemoryRange mappedRange = obtDevice.getAllocator().mappedRange(allocation, size, offset);
 	return vkInvalidateMappedMemoryRanges(obtDevice.device(), 1, &mappedRange);
 }
 
+/**
+ * Record a byte range written through the mapped pointer so the next flushDirty covers it
+ *
+ * @note Ranges are not recorded on coherent memory since it never needs flushing
+ *
+ * @param size (Optional) Size of the written range. Pass VK_WHOLE_SIZE to mark the rest of the
+ * buffer.
+ * @param offset (Optional) Byte offset from beginning of the buffer
+ */
+void ObtBuffer::markDirty(VkDeviceSize size, VkDeviceSize offset) {
+	if (isCoherent()) return;
+
+	VkDeviceSize end = size == VK_WHOLE_SIZE ? bufferSize : std::min(offset + size, bufferSize);
+	if (offset >= end) return;
+
+	// Sequential writes are the common case, extend the last range instead of adding one
+	if (!dirtyRanges.empty() && offset <= dirtyRanges.back().end && end >= dirtyRanges.back().begin) {
+		dirtyRanges.back().begin = std::min(dirtyRanges.back().begin, offset);
+		dirtyRanges.back().end = std::max(dirtyRanges.back().end, end);
+	} else {
+		dirtyRanges.push_back({offset, end});
+	}
+}
+
+/**
+ * Flush every range recorded by markDirty with a single vkFlushMappedMemoryRanges call
+ *
+ * @note Ranges are widened to nonCoherentAtomSize and merged where they overlap. Does nothing on
+ * coherent memory.
+ *
+ * @return VkResult of the flush call
+ */
+VkResult ObtBuffer::flushDirty() {
+	if (dirtyRanges.empty()) return VK_SUCCESS;
+
+	VkDeviceSize atomSize = obtDevice.properties.limits.nonCoherentAtomSize;
+	for (auto& range : dirtyRanges) {
+		range.begin = range.begin / atomSize * atomSize;
+		range.end = (range.end + atomSize - 1) / atomSize * atomSize;
+	}
+	std::sort(dirtyRanges.begin(), dirtyRanges.end(), [](const DirtyRange& a, const DirtyRange& b) { return a.begin < b.begin; });
+
+	std::vector<VkMappedMemoryRange> mappedRanges;
+	DirtyRange current = dirtyRanges[0];
+	for (size_t i = 1; i <= dirtyRanges.size(); i++) {
+		if (i < dirtyRanges.size() && dirtyRanges[i].begin <= current.end) {
+			current.end = std::max(current.end, dirtyRanges[i].end);
+			continue;
+		}
+		VkDeviceSize end = std::min(current.end, bufferSize);
+		mappedRanges.push_back(obtDevice.getAllocator().mappedRange(allocation, end - current.begin, current.begin));
+		if (i < dirtyRanges.size()) current = dirtyRanges[i];
+	}
+	dirtyRanges.clear();
+
+	return vkFlushMappedMemoryRanges(obtDevice.device(), static_cast<uint32_t>(mappedRanges.size()), mappedRanges.data());
+}
+
+/**
+ * Move the buffer to a new allocation with a GPU copy, used by the defragmenter
+ *
+ * @param commandBuffer Command buffer the copy is recorded into
+ * @param retired Receives the old buffer and memory, which must outlive the frames using them
+ */
+void ObtBuffer::relocate(VkCommandBuffer commandBuffer, ObtRetiredResource& retired) {
+	obtDevice.relocateBuffer(commandBuffer, bufferSize, usageFlags, memoryPropertyFlags, buffer, allocation, retired);
+	generation++;
+}
+
 /**
  * Create a buffer info descriptor
  *
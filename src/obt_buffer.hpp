@@ -2,9 +2,11 @@
 
 #include "obt_device.hpp"
 
+#include <vector>
+
 namespace obt {
 
-class ObtBuffer {
+class ObtBuffer : public ObtRelocatable {
 	public:
 		ObtBuffer(ObtDevice& device, VkDeviceSize instanceSize, uint32_t instanceCount, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize minOffsetAlignment = 1);
 		~ObtBuffer();
@@ -20,6 +22,9 @@ class ObtBuffer {
 		VkDescriptorBufferInfo descriptorInfo(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 		VkResult invalidate(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 
+		void markDirty(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		VkResult flushDirty();
+
 		void writeToIndex(void* data, int index);
 		VkResult flushIndex(int index);
 		VkDescriptorBufferInfo descriptorInfoForIndex(int index);
@@ -33,14 +38,30 @@ class ObtBuffer {
 		VkBufferUsageFlags getUsageFlags() const { return usageFlags; }
 		VkMemoryPropertyFlags getMemoryPropertyFlags() const { return memoryPropertyFlags; }
 		VkDeviceSize getBufferSize() const { return bufferSize; }
+		const ObtAllocation& getAllocation() const override { return allocation; }
+		void relocate(VkCommandBuffer commandBuffer, ObtRetiredResource& retired) override;
+		// Changes whenever relocation replaced the buffer and descriptor sets need to be rewritten
+		uint32_t getGeneration() const { return generation; }
+
+		bool isCoherent() const { return allocation.memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT; }
+		bool isWriteCombined() const { return !(allocation.memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT); }
 
 	private:
+		struct DirtyRange {
+			VkDeviceSize begin;
+			VkDeviceSize end;
+		};
+
 		static VkDeviceSize getAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment);
+		VkDeviceSize getMappedOffset() const { return static_cast<char*>(mapped) - static_cast<char*>(allocation.mapped); }
 
 		ObtDevice& obtDevice;
 		void* mapped = nullptr;
 		VkBuffer buffer = VK_NULL_HANDLE;
-		VkDeviceMemory memory = VK_NULL_HANDLE;
+		ObtAllocation allocation{};
+		std::vector<DirtyRange> dirtyRanges;
+
+		uint32_t generation = 0;
 
 		VkDeviceSize bufferSize;
 		uint32_t instanceCount;
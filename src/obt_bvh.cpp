@@ -0,0 +1,480 @@
+#include "obt_bvh.hpp"
+
+#include "obt_job_system.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace obt {
+
+static constexpr float INF = std::numeric_limits<float>::infinity();
+static constexpr uint32_t ALL_PLANES = (1u << 6) - 1;
+
+static float surfaceArea(const glm::vec3& min, const glm::vec3& max) {
+	glm::vec3 extent = glm::max(max - min, glm::vec3{0.f});
+	return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+static glm::vec3 sphereMin(const glm::vec4& sphere) { return glm::vec3{sphere} - sphere.w; }
+static glm::vec3 sphereMax(const glm::vec4& sphere) { return glm::vec3{sphere} + sphere.w; }
+
+static uint32_t binOf(float centroid, float centroidMin, float scale) {
+	return std::min(ObtBvh::BIN_COUNT - 1, static_cast<uint32_t>((centroid - centroidMin) * scale));
+}
+
+// Distance along the ray at which it enters the box, infinity when it misses
+static float rayEntry(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& min, const glm::vec3& max) {
+	float entry = 0.f;
+	float exit = INF;
+	for (int axis = 0; axis < 3; axis++) {
+		float t0 = (min[axis] - origin[axis]) * inverseDirection[axis];
+		float t1 = (max[axis] - origin[axis]) * inverseDirection[axis];
+		if (t0 > t1) std::swap(t0, t1);
+		entry = std::max(entry, t0);
+		exit = std::min(exit, t1);
+	}
+	return entry <= exit ? entry : INF;
+}
+
+static bool boxesOverlap(const glm::vec3& aMin, const glm::vec3& aMax, const glm::vec3& bMin, const glm::vec3& bMax) {
+	return aMin.x <= bMax.x && aMax.x >= bMin.x && aMin.y <= bMax.y && aMax.y >= bMin.y && aMin.z <= bMax.z && aMax.z >= bMin.z;
+}
+
+// Tests a box against the planes still in planeMask, clears the planes that contain the box and
+// returns whether the box is outside any of them
+static bool boxOutsidePlanes(const glm::vec3& min, const glm::vec3& max, const ObtFrustumPlanes& planes, uint32_t& planeMask) {
+	glm::vec3 center = (min + max) * 0.5f;
+	glm::vec3 extent = (max - min) * 0.5f;
+	for (uint32_t p = 0; p < 6; p++) {
+		if ((planeMask & (1u << p)) == 0) continue;
+
+		const glm::vec4& plane = planes[p];
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float radius = std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z;
+		if (distance + radius <= 0.f) return true;
+		if (distance - radius > 0.f) planeMask &= ~(1u << p);
+	}
+	return false;
+}
+
+/**
+ * Builds the tree from scratch
+ *
+ * @param spheres Bounding spheres indexed by object
+ * @param count Number of spheres
+ * @param jobSystem When set, subtrees below BUILD_GRAIN_SIZE objects are built in parallel
+ */
+void ObtBvh::build(const glm::vec4* spheres, uint32_t count, ObtJobSystem* jobSystem) {
+	objectIndices.clear();
+	leafSpheres.clear();
+	for (uint32_t i = 0; i < count; i++) {
+		if (spheres[i].w < 0.f) continue;
+		objectIndices.push_back(i);
+		leafSpheres.push_back(spheres[i]);
+	}
+
+	nodes.clear();
+	if (objectIndices.empty()) {
+		buildCost = cost = 0.f;
+		return;
+	}
+
+	nodes.reserve(2 * objectIndices.size());
+	nodes.push_back(Node{glm::vec3{0.f}, 0, glm::vec3{0.f}, static_cast<uint32_t>(objectIndices.size()), 0});
+
+	std::vector<uint32_t> stack{0};
+	std::vector<uint32_t> subtrees;
+	while (!stack.empty()) {
+		uint32_t nodeIndex = stack.back();
+		stack.pop_back();
+		if (jobSystem != nullptr && nodes[nodeIndex].count <= BUILD_GRAIN_SIZE) {
+			subtrees.push_back(nodeIndex);
+			continue;
+		}
+		subdivide(nodes, nodeIndex, stack);
+	}
+	if (!subtrees.empty()) {
+		buildSubtrees(subtrees, *jobSystem);
+	}
+
+	buildCost = cost = computeCost();
+}
+
+/**
+ * Builds the subtrees below the given nodes in parallel, each into its own node list since they
+ * only share the object arrays, in which every subtree owns a disjoint range
+ */
+void ObtBvh::buildSubtrees(const std::vector<uint32_t>& subtrees, ObtJobSystem& jobSystem) {
+	std::vector<std::vector<Node>> subtreeNodes(subtrees.size());
+	jobSystem.parallelFor(static_cast<uint32_t>(subtrees.size()), 1, [&](uint32_t begin, uint32_t end) {
+		std::vector<uint32_t> stack;
+		for (uint32_t s = begin; s < end; s++) {
+			std::vector<Node>& tree = subtreeNodes[s];
+			tree.push_back(nodes[subtrees[s]]);
+			stack.push_back(0);
+			while (!stack.empty()) {
+				uint32_t nodeIndex = stack.back();
+				stack.pop_back();
+				subdivide(tree, nodeIndex, stack);
+			}
+		}
+	});
+
+	// The subtree root replaces the node it was built from and the rest is appended with shifted
+	// child links, children still come after their parent and next to each other
+	for (size_t s = 0; s < subtrees.size(); s++) {
+		const std::vector<Node>& tree = subtreeNodes[s];
+		uint32_t base = static_cast<uint32_t>(nodes.size()) - 1;
+		auto relink = [base](Node node) {
+			if (!node.isLeaf()) node.left += base;
+			return node;
+		};
+		nodes[subtrees[s]] = relink(tree[0]);
+		for (size_t i = 1; i < tree.size(); i++) {
+			nodes.push_back(relink(tree[i]));
+		}
+	}
+}
+
+/**
+ * Computes the bounds of a node and splits it at the cheapest of BIN_COUNT candidate planes per
+ * axis, queueing the children for further subdivision
+ *
+ * @param tree Node list the node belongs to and its children are appended to
+ */
+void ObtBvh::subdivide(std::vector<Node>& tree, uint32_t nodeIndex, std::vector<uint32_t>& stack) {
+	updateLeafBounds(tree[nodeIndex]);
+	Node node = tree[nodeIndex];
+	if (node.count <= MAX_LEAF_SIZE) return;
+
+	uint32_t end = node.first + node.count;
+	glm::vec3 centroidMin{INF};
+	glm::vec3 centroidMax{-INF};
+	for (uint32_t i = node.first; i < end; i++) {
+		centroidMin = glm::min(centroidMin, glm::vec3{leafSpheres[i]});
+		centroidMax = glm::max(centroidMax, glm::vec3{leafSpheres[i]});
+	}
+
+	float bestCost = INF;
+	int bestAxis = -1;
+	uint32_t bestSplit = 0;
+	for (int axis = 0; axis < 3; axis++) {
+		float extent = centroidMax[axis] - centroidMin[axis];
+		if (extent <= 0.f) continue;
+
+		Bin bins[BIN_COUNT];
+		for (auto& bin : bins) {
+			bin = Bin{glm::vec3{INF}, glm::vec3{-INF}, 0};
+		}
+		float scale = BIN_COUNT / extent;
+		for (uint32_t i = node.first; i < end; i++) {
+			Bin& bin = bins[binOf(leafSpheres[i][axis], centroidMin[axis], scale)];
+			bin.min = glm::min(bin.min, sphereMin(leafSpheres[i]));
+			bin.max = glm::max(bin.max, sphereMax(leafSpheres[i]));
+			bin.count++;
+		}
+
+		// Sweep from both sides to get the area and count on either side of every bin boundary
+		float leftArea[BIN_COUNT - 1];
+		uint32_t leftCount[BIN_COUNT - 1];
+		glm::vec3 boxMin{INF};
+		glm::vec3 boxMax{-INF};
+		uint32_t sum = 0;
+		for (uint32_t b = 0; b < BIN_COUNT - 1; b++) {
+			boxMin = glm::min(boxMin, bins[b].min);
+			boxMax = glm::max(boxMax, bins[b].max);
+			sum += bins[b].count;
+			leftArea[b] = surfaceArea(boxMin, boxMax);
+			leftCount[b] = sum;
+		}
+		boxMin = glm::vec3{INF};
+		boxMax = glm::vec3{-INF};
+		sum = 0;
+		for (uint32_t b = BIN_COUNT - 1; b > 0; b--) {
+			boxMin = glm::min(boxMin, bins[b].min);
+			boxMax = glm::max(boxMax, bins[b].max);
+			sum += bins[b].count;
+			if (leftCount[b - 1] == 0 || sum == 0) continue;
+
+			float splitCost = leftCount[b - 1] * leftArea[b - 1] + sum * surfaceArea(boxMin, boxMax);
+			if (splitCost < bestCost) {
+				bestCost = splitCost;
+				bestAxis = axis;
+				bestSplit = b;
+			}
+		}
+	}
+
+	uint32_t middle = node.first;
+	if (bestAxis >= 0 && bestCost < node.count * surfaceArea(node.min, node.max)) {
+		float scale = BIN_COUNT / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+		uint32_t last = end;
+		while (middle < last) {
+			if (binOf(leafSpheres[middle][bestAxis], centroidMin[bestAxis], scale) < bestSplit) {
+				middle++;
+			} else {
+				last--;
+				std::swap(objectIndices[middle], objectIndices[last]);
+				std::swap(leafSpheres[middle], leafSpheres[last]);
+			}
+		}
+	} else if (node.count > 4 * MAX_LEAF_SIZE) {
+		// Coincident centroids or no split beating a leaf, halve the range to keep leaves small
+		middle = node.first + node.count / 2;
+	} else {
+		return;
+	}
+
+	uint32_t left = static_cast<uint32_t>(tree.size());
+	tree[nodeIndex].left = left;
+	tree.push_back(Node{glm::vec3{0.f}, node.first, glm::vec3{0.f}, middle - node.first, 0});
+	tree.push_back(Node{glm::vec3{0.f}, middle, glm::vec3{0.f}, end - middle, 0});
+	stack.push_back(left);
+	stack.push_back(left + 1);
+}
+
+void ObtBvh::updateLeafBounds(Node& node) const {
+	node.min = glm::vec3{INF};
+	node.max = glm::vec3{-INF};
+	for (uint32_t i = node.first; i < node.first + node.count; i++) {
+		node.min = glm::min(node.min, sphereMin(leafSpheres[i]));
+		node.max = glm::max(node.max, sphereMax(leafSpheres[i]));
+	}
+}
+
+/**
+ * Expected cost of a query relative to testing the root box, inner nodes count one box test and
+ * leaves one test per object, each weighted by the chance of a random ray hitting the node
+ */
+float ObtBvh::computeCost() const {
+	float rootArea = surfaceArea(nodes[0].min, nodes[0].max);
+	if (rootArea <= 0.f) return 0.f;
+
+	float total = 0.f;
+	for (const auto& node : nodes) {
+		total += surfaceArea(node.min, node.max) * (node.isLeaf() ? node.count : 1.f);
+	}
+	return total / rootArea;
+}
+
+/**
+ * Updates the node boxes to the current spheres without changing the tree structure
+ *
+ * @param spheres Bounding spheres indexed by object, must hold every object the tree was built with
+ * @param jobSystem When set, leaves are refit in parallel before the inner nodes are swept
+ */
+void ObtBvh::refit(const glm::vec4* spheres, ObtJobSystem* jobSystem) {
+	if (nodes.empty()) return;
+
+	// Leaves cover disjoint object ranges that together hold every object
+	auto refitLeaves = [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++) {
+			Node& node = nodes[i];
+			if (!node.isLeaf()) continue;
+
+			for (uint32_t object = node.first; object < node.first + node.count; object++) {
+				leafSpheres[object] = spheres[objectIndices[object]];
+			}
+			updateLeafBounds(node);
+		}
+	};
+	uint32_t nodeCount = static_cast<uint32_t>(nodes.size());
+	if (jobSystem != nullptr) {
+		jobSystem->parallelFor(nodeCount, REFIT_GRAIN_SIZE, refitLeaves);
+	} else {
+		refitLeaves(0, nodeCount);
+	}
+
+	// Children are always stored after their parent, so a reverse sweep sees them first
+	for (size_t i = nodes.size(); i-- > 0;) {
+		Node& node = nodes[i];
+		if (!node.isLeaf()) {
+			node.min = glm::min(nodes[node.left].min, nodes[node.left + 1].min);
+			node.max = glm::max(nodes[node.left].max, nodes[node.left + 1].max);
+		}
+	}
+
+	cost = computeCost();
+}
+
+void ObtBvh::appendRange(const Node& node, const uint32_t* flags, uint32_t requiredFlags, std::vector<uint32_t>& visible) const {
+	for (uint32_t i = node.first; i < node.first + node.count; i++) {
+		uint32_t object = objectIndices[i];
+		if (leafSpheres[i].w >= 0.f && (flags[object] & requiredFlags) == requiredFlags) visible.push_back(object);
+	}
+}
+
+/**
+ * Collects the objects whose spheres intersect the frustum. Subtrees fully inside skip all further
+ * plane tests and small partially visible subtrees are handed to the SIMD sphere culler.
+ *
+ * @note Unlike the linear culler the visible indices are not sorted
+ *
+ * @param jobSystem When set, the nodes above CULL_GRAIN_SIZE objects are tested on the calling
+ * thread and the subtrees below them are culled in parallel
+ */
+void ObtBvh::cullFrustum(const ObtFrustumPlanes& planes, const uint32_t* flags, uint32_t requiredFlags, std::vector<uint32_t>& visible, ObtJobSystem* jobSystem) const {
+	visible.clear();
+	if (nodes.empty()) return;
+
+	if (jobSystem == nullptr || nodes[0].count <= CULL_GRAIN_SIZE) {
+		cullSubtree(0, ALL_PLANES, planes, flags, requiredFlags, visible);
+		return;
+	}
+
+	std::vector<std::pair<uint32_t, uint32_t>> subtrees;
+	std::vector<std::pair<uint32_t, uint32_t>> stack{{0, ALL_PLANES}};
+	while (!stack.empty()) {
+		auto [nodeIndex, planeMask] = stack.back();
+		stack.pop_back();
+		const Node& node = nodes[nodeIndex];
+		if (node.isLeaf() || node.count <= CULL_GRAIN_SIZE) {
+			subtrees.emplace_back(nodeIndex, planeMask);
+			continue;
+		}
+
+		if (boxOutsidePlanes(node.min, node.max, planes, planeMask)) continue;
+		stack.emplace_back(node.left, planeMask);
+		stack.emplace_back(node.left + 1, planeMask);
+	}
+
+	// Every subtree collects into its own list, the lists are joined in order afterwards
+	std::vector<std::vector<uint32_t>> subtreeVisible(subtrees.size());
+	jobSystem->parallelFor(static_cast<uint32_t>(subtrees.size()), 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t s = begin; s < end; s++) {
+			cullSubtree(subtrees[s].first, subtrees[s].second, planes, flags, requiredFlags, subtreeVisible[s]);
+		}
+	});
+
+	size_t total = 0;
+	for (const auto& list : subtreeVisible) total += list.size();
+	visible.reserve(total);
+	for (const auto& list : subtreeVisible) {
+		visible.insert(visible.end(), list.begin(), list.end());
+	}
+}
+
+/**
+ * Appends the visible objects below a node to visible
+ *
+ * @param planeMask Planes the node may still straddle, the others are known to contain it
+ */
+void ObtBvh::cullSubtree(uint32_t root, uint32_t planeMask, const ObtFrustumPlanes& planes, const uint32_t* flags, uint32_t requiredFlags, std::vector<uint32_t>& visible) const {
+	// Each entry carries the planes its box still straddles, planes that contain a node contain
+	// all of its descendants as well
+	std::vector<std::pair<uint32_t, uint32_t>> stack{{root, planeMask}};
+	while (!stack.empty()) {
+		auto [nodeIndex, nodePlaneMask] = stack.back();
+		stack.pop_back();
+		const Node& node = nodes[nodeIndex];
+		if (boxOutsidePlanes(node.min, node.max, planes, nodePlaneMask)) continue;
+
+		if (nodePlaneMask == 0) {
+			appendRange(node, flags, requiredFlags, visible);
+		} else if (node.isLeaf() || node.count <= SIMD_CULL_THRESHOLD) {
+			size_t base = visible.size();
+			visible.resize(base + node.count);
+			uint32_t culled = cullSpheres(planes, leafSpheres.data(), nullptr, 0, node.first, node.first + node.count, visible.data() + base);
+
+			size_t written = base;
+			for (size_t i = base; i < base + culled; i++) {
+				uint32_t object = objectIndices[visible[i]];
+				if ((flags[object] & requiredFlags) == requiredFlags) visible[written++] = object;
+			}
+			visible.resize(written);
+		} else {
+			stack.emplace_back(node.left, nodePlaneMask);
+			stack.emplace_back(node.left + 1, nodePlaneMask);
+		}
+	}
+}
+
+/**
+ * Finds the closest object whose bounding sphere the ray hits, meant for picking
+ *
+ * @param direction Ray direction, does not need to be normalized
+ * @param maxDistance Hits further along the ray than this are ignored
+ * @param hitIndex Receives the object index of the hit
+ * @param hitDistance Receives the distance from the origin to the hit, zero when starting inside
+ *
+ * @return Whether anything was hit
+ */
+bool ObtBvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, uint32_t& hitIndex, float& hitDistance) const {
+	if (nodes.empty()) return false;
+
+	glm::vec3 dir = glm::normalize(direction);
+	glm::vec3 inverseDirection{1.f / dir.x, 1.f / dir.y, 1.f / dir.z};
+	float closest = maxDistance;
+	bool hit = false;
+
+	std::vector<uint32_t> stack{0};
+	while (!stack.empty()) {
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		if (rayEntry(origin, inverseDirection, node.min, node.max) > closest) continue;
+
+		if (node.isLeaf()) {
+			for (uint32_t i = node.first; i < node.first + node.count; i++) {
+				const glm::vec4& sphere = leafSpheres[i];
+				if (sphere.w < 0.f) continue;
+
+				glm::vec3 toCenter = glm::vec3{sphere} - origin;
+				float along = glm::dot(toCenter, dir);
+				float discriminant = along * along - glm::dot(toCenter, toCenter) + sphere.w * sphere.w;
+				if (discriminant < 0.f) continue;
+
+				float halfChord = std::sqrt(discriminant);
+				if (along + halfChord < 0.f) continue;
+
+				float distance = std::max(along - halfChord, 0.f);
+				if (distance <= closest) {
+					closest = distance;
+					hitIndex = objectIndices[i];
+					hit = true;
+				}
+			}
+			continue;
+		}
+
+		// Visit the nearer child first so it can tighten the distance before the other is tested
+		float leftEntry = rayEntry(origin, inverseDirection, nodes[node.left].min, nodes[node.left].max);
+		float rightEntry = rayEntry(origin, inverseDirection, nodes[node.left + 1].min, nodes[node.left + 1].max);
+		uint32_t nearChild = leftEntry <= rightEntry ? node.left : node.left + 1;
+		uint32_t farChild = leftEntry <= rightEntry ? node.left + 1 : node.left;
+		if (std::max(leftEntry, rightEntry) <= closest) stack.push_back(farChild);
+		if (std::min(leftEntry, rightEntry) <= closest) stack.push_back(nearChild);
+	}
+
+	if (hit) hitDistance = closest;
+	return hit;
+}
+
+/**
+ * Collects the objects whose sphere bounding boxes overlap the given box
+ */
+void ObtBvh::queryOverlap(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& results) const {
+	results.clear();
+	if (nodes.empty()) return;
+
+	std::vector<uint32_t> stack{0};
+	while (!stack.empty()) {
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		if (!boxesOverlap(node.min, node.max, min, max)) continue;
+
+		if (node.isLeaf()) {
+			for (uint32_t i = node.first; i < node.first + node.count; i++) {
+				if (leafSpheres[i].w >= 0.f && boxesOverlap(sphereMin(leafSpheres[i]), sphereMax(leafSpheres[i]), min, max)) {
+					results.push_back(objectIndices[i]);
+				}
+			}
+		} else {
+			stack.push_back(node.left);
+			stack.push_back(node.left + 1);
+		}
+	}
+}
+
+}
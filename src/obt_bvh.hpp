@@ -0,0 +1,87 @@
+#pragma once
+
+#include "obt_frustum_culling.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace obt {
+
+class ObtJobSystem;
+
+// Bounding volume hierarchy over bounding spheres (center in xyz, radius in w), built top down
+// with binned surface area heuristic splits. Moving objects are handled by refitting the node
+// boxes, which slowly degrades the tree, so needsRebuild() reports when the refitted tree has
+// become expensive enough that a fresh build pays off.
+//
+// Objects are referenced by their index in the sphere array, spheres with a negative radius are
+// left out of the tree and never returned by any query.
+//
+// With a job system, building, refitting and frustum culling split the tree into subtrees below a
+// grain size that are processed in parallel, the result is the same as without one.
+class ObtBvh {
+	public:
+		static constexpr uint32_t BIN_COUNT = 16;
+		static constexpr uint32_t MAX_LEAF_SIZE = 4;
+		static constexpr uint32_t SIMD_CULL_THRESHOLD = 64;
+		static constexpr float REBUILD_COST_RATIO = 1.5f;
+		static constexpr uint32_t BUILD_GRAIN_SIZE = 16 * 1024;
+		static constexpr uint32_t REFIT_GRAIN_SIZE = 1024;
+
+		ObtBvh() = default;
+
+		ObtBvh(const ObtBvh&) = delete;
+		ObtBvh &operator=(const ObtBvh&) = delete;
+
+		void build(const glm::vec4* spheres, uint32_t count, ObtJobSystem* jobSystem = nullptr);
+		void refit(const glm::vec4* spheres, ObtJobSystem* jobSystem = nullptr);
+		bool needsRebuild() const { return !nodes.empty() && cost > buildCost * REBUILD_COST_RATIO; }
+
+		void cullFrustum(const ObtFrustumPlanes& planes, const uint32_t* flags, uint32_t requiredFlags, std::vector<uint32_t>& visible, ObtJobSystem* jobSystem = nullptr) const;
+		bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, uint32_t& hitIndex, float& hitDistance) const;
+		void queryOverlap(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& results) const;
+
+		uint32_t getNodeCount() const { return static_cast<uint32_t>(nodes.size()); }
+		uint32_t getObjectCount() const { return static_cast<uint32_t>(objectIndices.size()); }
+		float getCost() const { return cost; }
+
+	private:
+		// Every node covers the contiguous range [first, first + count) of objectIndices, leaves
+		// have no children and the children of an inner node are stored next to each other
+		struct Node {
+			glm::vec3 min;
+			uint32_t first;
+			glm::vec3 max;
+			uint32_t count;
+			uint32_t left;
+
+			bool isLeaf() const { return left == 0; }
+		};
+
+		struct Bin {
+			glm::vec3 min;
+			glm::vec3 max;
+			uint32_t count;
+		};
+
+		void subdivide(std::vector<Node>& tree, uint32_t nodeIndex, std::vector<uint32_t>& stack);
+		void buildSubtrees(const std::vector<uint32_t>& subtrees, ObtJobSystem& jobSystem);
+		void updateLeafBounds(Node& node) const;
+		float computeCost() const;
+		void appendRange(const Node& node, const uint32_t* flags, uint32_t requiredFlags, std::vector<uint32_t>& visible) const;
+		void cullSubtree(uint32_t root, uint32_t planeMask, const ObtFrustumPlanes& planes, const uint32_t* flags, uint32_t requiredFlags, std::vector<uint32_t>& visible) const;
+
+		std::vector<Node> nodes;
+		std::vector<uint32_t> objectIndices;
+		// Spheres copied in the order of objectIndices, so every node's objects are contiguous
+		std::vector<glm::vec4> leafSpheres;
+
+		float buildCost = 0.f;
+		float cost = 0.f;
+};
+
+}
@@ -13,6 +13,7 @@ void ObtCamera::setOrthographicProjection(float left, float right, float top, fl
 	projectionMatrix[3][0] = -(right + left) / (right - left);
 	projectionMatrix[3][1] = -(bottom + top) / (bottom - top);
 	projectionMatrix[3][2] = -near / (far - near);
+	farDistance = far;
 }
 
 void ObtCamera::setPerspectiveProjection(float fovy, float aspect, float near, float far) {
@@ -24,6 +25,7 @@ void ObtCamera::setPerspectiveProjection(float fovy, float aspect, float near, f
 	projectionMatrix[2][2] = far / (far - near);
 	projectionMatrix[2][3] = 1.f;
 	projectionMatrix[3][2] = -(far * near) / (far - near);
+	farDistance = far;
 }
 
 
@@ -80,4 +82,32 @@ void ObtCamera::setViewQuat(glm::vec3 position, glm::quat rotation) {
 	viewMatrix = glm::inverse(glm::translate(glm::mat4{1.f}, position) * glm::mat4_cast(rotation));
 }
 
+/**
+ * Extracts the world space frustum planes from the combined projection and view matrix
+ *
+ * @return Left, right, bottom, top, near and far plane as normal and distance, normalized and
+ * facing inwards so a point p is inside when dot(plane.xyz, p) + plane.w >= 0
+ */
+std::array<glm::vec4, 6> ObtCamera::getFrustumPlanes() const {
+	const glm::mat4 m = projectionMatrix * viewMatrix;
+	const glm::vec4 row0{m[0][0], m[1][0], m[2][0], m[3][0]};
+	const glm::vec4 row1{m[0][1], m[1][1], m[2][1], m[3][1]};
+	const glm::vec4 row2{m[0][2], m[1][2], m[2][2], m[3][2]};
+	const glm::vec4 row3{m[0][3], m[1][3], m[2][3], m[3][3]};
+
+	// Depth ranges from 0 to 1, so the near plane is the third row alone
+	std::array<glm::vec4, 6> planes{
+		row3 + row0,
+		row3 - row0,
+		row3 + row1,
+		row3 - row1,
+		row2,
+		row3 - row2
+	};
+	for (auto& plane : planes) {
+		plane /= glm::length(glm::vec3{plane});
+	}
+	return planes;
+}
+
 }
@@ -5,6 +5,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#include <array>
+
 namespace obt {
 
 class ObtCamera {
@@ -19,10 +21,13 @@ class ObtCamera {
 
 		const glm::mat4& getProjection() const { return projectionMatrix; }
 		const glm::mat4& getView() const { return viewMatrix; }
+		float getFar() const { return farDistance; }
+		std::array<glm::vec4, 6> getFrustumPlanes() const;
 
 	private:
 		glm::mat4 projectionMatrix{1.f};
 		glm::mat4 viewMatrix{1.f};
+		float farDistance = 1.f;
 };
 
 }
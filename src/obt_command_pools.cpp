@@ -0,0 +1,98 @@
+#include "obt_command_pools.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace obt {
+
+ObtCommandPools::ObtCommandPools(ObtDevice& obtDevice, uint32_t frameCount, uint32_t threadCount)
+	: obtDevice{obtDevice}, frameCount{std::max(frameCount, 1u)}, threadCount{std::max(threadCount, 1u)} {
+	// Buffers are only ever reset together with their pool, so the pool needs no per buffer reset
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = obtDevice.findPhysicalQueueFamilies().graphicsFamily;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	pools.resize(this->frameCount * this->threadCount);
+	for (auto& pool : pools) {
+		if (vkCreateCommandPool(obtDevice.device(), &poolInfo, nullptr, &pool.pool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create command pool!");
+		}
+	}
+}
+
+ObtCommandPools::~ObtCommandPools() {
+	for (auto& pool : pools) {
+		vkDestroyCommandPool(obtDevice.device(), pool.pool, nullptr);
+	}
+}
+
+/**
+ * Resets every thread's pool of a frame, all command buffers acquired from them return to the
+ * initial state and are handed out again
+ *
+ * @note Only call once the GPU is done with the frame, e.g. after its fence has been waited on,
+ * and while no thread records into the frame's buffers
+ */
+void ObtCommandPools::reset(uint32_t frameIndex) {
+	assert(frameIndex < frameCount && "Frame index out of range!");
+	for (uint32_t thread = 0; thread < threadCount; thread++) {
+		Pool& pool = getPool(frameIndex, thread);
+		if (pool.primary.used == 0 && pool.secondary.used == 0) continue;
+
+		vkResetCommandPool(obtDevice.device(), pool.pool, 0);
+		pool.primary.used = 0;
+		pool.secondary.used = 0;
+	}
+}
+
+void ObtCommandPools::allocate(Pool& pool, VkCommandBufferLevel level, uint32_t count) {
+	CommandBuffers& buffers = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? pool.primary : pool.secondary;
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = level;
+	allocInfo.commandPool = pool.pool;
+	allocInfo.commandBufferCount = count;
+
+	size_t first = buffers.commandBuffers.size();
+	buffers.commandBuffers.resize(first + count);
+	if (vkAllocateCommandBuffers(obtDevice.device(), &allocInfo, buffers.commandBuffers.data() + first) != VK_SUCCESS) {
+		buffers.commandBuffers.resize(first);
+		throw std::runtime_error("Failed to allocate command buffers!");
+	}
+}
+
+/**
+ * Makes sure every thread's pool of a frame has count unused command buffers of a level, so
+ * acquiring them from jobs, which must not throw, never allocates
+ *
+ * @note Touches the pools of all threads, only call while none of them records into the frame
+ */
+void ObtCommandPools::reserve(uint32_t frameIndex, VkCommandBufferLevel level, uint32_t count) {
+	assert(frameIndex < frameCount && "Frame index out of range!");
+	for (uint32_t thread = 0; thread < threadCount; thread++) {
+		Pool& pool = getPool(frameIndex, thread);
+		CommandBuffers& buffers = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? pool.primary : pool.secondary;
+		uint32_t available = static_cast<uint32_t>(buffers.commandBuffers.size()) - buffers.used;
+		if (available < count) allocate(pool, level, count - available);
+	}
+}
+
+/**
+ * Hands out the next unused command buffer of a thread's pool, allocating one if none is left.
+ * The buffer is in the initial state and stays valid until the frame's pools are reset.
+ *
+ * @param threadIndex Index of the calling thread, each thread may only acquire from its own pools
+ */
+VkCommandBuffer ObtCommandPools::acquire(uint32_t frameIndex, uint32_t threadIndex, VkCommandBufferLevel level) {
+	assert(frameIndex < frameCount && "Frame index out of range!");
+	assert(threadIndex < threadCount && "Thread index out of range!");
+	Pool& pool = getPool(frameIndex, threadIndex);
+	CommandBuffers& buffers = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? pool.primary : pool.secondary;
+	if (buffers.used == buffers.commandBuffers.size()) allocate(pool, level, 1);
+	return buffers.commandBuffers[buffers.used++];
+}
+
+}
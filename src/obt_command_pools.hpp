@@ -0,0 +1,48 @@
+#pragma once
+
+#include "obt_device.hpp"
+
+#include <vector>
+
+namespace obt {
+
+// Command pools for every frame in flight and recording thread, so threads record without locking
+// and a frame's command buffers are recycled by resetting its pools as a whole instead of one
+// buffer at a time. Command buffers stay allocated across resets and are handed out again in order.
+class ObtCommandPools {
+	public:
+		ObtCommandPools(ObtDevice& obtDevice, uint32_t frameCount, uint32_t threadCount);
+		~ObtCommandPools();
+
+		ObtCommandPools(const ObtCommandPools&) = delete;
+		ObtCommandPools &operator=(const ObtCommandPools&) = delete;
+
+		void reset(uint32_t frameIndex);
+		void reserve(uint32_t frameIndex, VkCommandBufferLevel level, uint32_t count);
+		VkCommandBuffer acquire(uint32_t frameIndex, uint32_t threadIndex, VkCommandBufferLevel level);
+
+		uint32_t getFrameCount() const { return frameCount; }
+		uint32_t getThreadCount() const { return threadCount; }
+
+	private:
+		struct CommandBuffers {
+			std::vector<VkCommandBuffer> commandBuffers;
+			uint32_t used = 0;
+		};
+
+		struct Pool {
+			VkCommandPool pool = VK_NULL_HANDLE;
+			CommandBuffers primary;
+			CommandBuffers secondary;
+		};
+
+		Pool& getPool(uint32_t frameIndex, uint32_t threadIndex) { return pools[frameIndex * threadCount + threadIndex]; }
+		void allocate(Pool& pool, VkCommandBufferLevel level, uint32_t count);
+
+		ObtDevice& obtDevice;
+		uint32_t frameCount;
+		uint32_t threadCount;
+		std::vector<Pool> pools;
+};
+
+}
@@ -0,0 +1,88 @@
+#include "obt_defragmenter.hpp"
+
+#include "obt_swap_chain.hpp"
+
+namespace obt {
+
+ObtDefragmenter::ObtDefragmenter(ObtDevice& obtDevice, VkDeviceSize frameBudget, float maxBlockUsage)
+	: obtDevice{obtDevice}, frameBudget{frameBudget}, maxBlockUsage{maxBlockUsage} {}
+
+ObtDefragmenter::~ObtDefragmenter() {
+	if (active) obtDevice.getAllocator().endDefragmentation();
+	releaseRetired(true);
+}
+
+void ObtDefragmenter::releaseRetired(bool all) {
+	size_t kept = 0;
+	for (size_t i = 0; i < retired.size(); i++) {
+		if (all || retired[i].frame + ObtSwapChain::MAX_FRAMES_IN_FLIGHT <= frameCount) {
+			obtDevice.destroyRetired(retired[i].resource);
+		} else {
+			retired[kept++] = retired[i];
+		}
+	}
+	retired.resize(kept);
+}
+
+/**
+ * Moves resources out of marked blocks until the frame budget is used up, must be recorded outside
+ * of a render pass and before anything in the frame reads the moved resources
+ *
+ * @note Resources retired by a step are destroyed MAX_FRAMES_IN_FLIGHT steps later, once every
+ * frame that could still reference them has finished
+ *
+ * @param commandBuffer Command buffer of the current frame
+ */
+void ObtDefragmenter::step(VkCommandBuffer commandBuffer) {
+	frameCount++;
+	releaseRetired(false);
+
+	ObtAllocator& allocator = obtDevice.getAllocator();
+	if (!active) {
+		if (--framesUntilCheck > 0) return;
+		framesUntilCheck = CHECK_INTERVAL;
+
+		active = allocator.beginDefragmentation(maxBlockUsage) > 0;
+		if (!active) return;
+	}
+
+	VkDeviceSize frameBytes = 0;
+	bool finished = true;
+	// Held for the whole loop, a resource destroyed by another thread would otherwise be relocated
+	// after its destructor ran
+	std::lock_guard<std::mutex> lock{obtDevice.relocatablesMutex()};
+	for (ObtRelocatable* resource : obtDevice.getRelocatables()) {
+		const ObtAllocation& allocation = resource->getAllocation();
+		if (!allocator.isEvacuating(allocation)) continue;
+
+		// Always move at least one resource so a single large one can't stall the pass
+		if (frameBytes > 0 && frameBytes + allocation.size > frameBudget) {
+			finished = false;
+			break;
+		}
+
+		Retired entry{{}, frameCount};
+		resource->relocate(commandBuffer, entry.resource);
+		frameBytes += entry.resource.allocation.size;
+		retired.push_back(entry);
+	}
+
+	if (frameBytes > 0) {
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		// Moved buffers are also read and written by compute passes and read as indirect commands
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		VkPipelineStageFlags dstStages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		movedBytes += frameBytes;
+	}
+
+	if (finished) {
+		allocator.endDefragmentation();
+		active = false;
+	}
+}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "obt_device.hpp"
+
+#include <vector>
+
+namespace obt {
+
+// Incrementally moves live resources out of sparsely used device local blocks so the allocator can
+// release them, a bounded number of bytes is copied per frame
+class ObtDefragmenter {
+	public:
+		static constexpr VkDeviceSize DEFAULT_FRAME_BUDGET = 8 * 1024 * 1024;
+		static constexpr uint32_t CHECK_INTERVAL = 300;
+
+		ObtDefragmenter(ObtDevice& obtDevice, VkDeviceSize frameBudget = DEFAULT_FRAME_BUDGET, float maxBlockUsage = .5f);
+		~ObtDefragmenter();
+
+		ObtDefragmenter(const ObtDefragmenter&) = delete;
+		ObtDefragmenter &operator=(const ObtDefragmenter&) = delete;
+
+		void step(VkCommandBuffer commandBuffer);
+
+		bool isActive() const { return active; }
+		VkDeviceSize getMovedBytes() const { return movedBytes; }
+
+	private:
+		struct Retired {
+			ObtRetiredResource resource;
+			uint64_t frame;
+		};
+
+		void releaseRetired(bool all);
+
+		ObtDevice& obtDevice;
+		VkDeviceSize frameBudget;
+		float maxBlockUsage;
+
+		bool active = false;
+		uint32_t framesUntilCheck = CHECK_INTERVAL;
+		uint64_t frameCount = 0;
+		VkDeviceSize movedBytes = 0;
+		std::vector<Retired> retired;
+};
+
+}
@@ -1,6 +1,10 @@
 #include "obt_device.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <cstring>
+#include <iomanip>
 #include <iostream>
 #include <set>
 #include <unordered_set>
@@ -35,11 +39,17 @@ ObtDevice::ObtDevice(ObtWindow &window) : window{window} {
 	createSurface();
 	pickPhysicalDevice();
 	createLogicalDevice();
-	createCommandPool();
+	createAllocator();
 }
 
 ObtDevice::~ObtDevice() {
-	vkDestroyCommandPool(device_, commandPool, nullptr);
+	allocator.reset();
+	for (auto& singleTimeCommandPool : singleTimeCommandPools) {
+		vkDestroyCommandPool(device_, singleTimeCommandPool.second, nullptr);
+	}
+	for (auto commandPool : freeCommandPools) {
+		vkDestroyCommandPool(device_, commandPool, nullptr);
+	}
 	vkDestroyDevice(device_, nullptr);
 
 	if (enableValidationLayers) {
@@ -131,8 +141,13 @@ void ObtDevice::createLogicalDevice() {
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+	deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
 
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -140,9 +155,28 @@ void ObtDevice::createLogicalDevice() {
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+	// Budget queries need VK_KHR_get_physical_device_properties2 on the instance as well
+	std::vector<const char *> extensions = deviceExtensions;
+	if (checkInstanceExtensionSupport(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+		getPhysicalDeviceMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+	}
+	if (getPhysicalDeviceMemoryProperties2 != nullptr && checkOptionalDeviceExtensionSupport(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+		extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		memoryBudgetSupported = true;
+	}
+
+	multiDrawIndirectSupported = supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance;
+
+	// GPU driven rendering writes one draw per object with the object index as first instance
+	bool drawIndirectCount = multiDrawIndirectSupported &&
+		checkOptionalDeviceExtensionSupport(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	if (drawIndirectCount) {
+		extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	}
+
 	createInfo.pEnabledFeatures = &deviceFeatures;
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	createInfo.ppEnabledExtensionNames = extensions.data();
 
 	// might not really be necessary anymore because device specific validation layers
 	// have been deprecated
@@ -159,19 +193,41 @@ void ObtDevice::createLogicalDevice() {
 
 	vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
 	vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+
+	if (drawIndirectCount) {
+		cmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(device_, "vkCmdDrawIndexedIndirectCountKHR");
+	}
 }
 
-void ObtDevice::createCommandPool() {
+/**
+ * @return A pool no other recording uses, taken from the free list or created when all are busy
+ */
+VkCommandPool ObtDevice::acquireCommandPool() {
+	{
+		std::lock_guard<std::mutex> lock{commandPoolMutex};
+		if (!freeCommandPools.empty()) {
+			VkCommandPool commandPool = freeCommandPools.back();
+			freeCommandPools.pop_back();
+			return commandPool;
+		}
+	}
+
 	QueueFamilyIndices queueFamilyIndices = findPhysicalQueueFamilies();
 
 	VkCommandPoolCreateInfo poolInfo = {};
 	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
-	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 
+	VkCommandPool commandPool;
 	if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create command pool!");
 	}
+	return commandPool;
+}
+
+void ObtDevice::createAllocator() {
+	allocator = std::make_unique<ObtAllocator>(device_, physicalDevice, properties);
 }
 
 void ObtDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
@@ -247,6 +303,10 @@ std::vector<const char *> ObtDevice::getRequiredExtensions() {
 		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 	}
 
+	if (checkInstanceExtensionSupport(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+		extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+	}
+
 	return extensions;
 }
 
@@ -293,6 +353,30 @@ bool ObtDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
 	return requiredExtensions.empty();
 }
 
+bool ObtDevice::checkInstanceExtensionSupport(const char *extensionName) {
+	uint32_t extensionCount = 0;
+	vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+
+	for (const auto &extension : extensions) {
+		if (strcmp(extension.extensionName, extensionName) == 0) return true;
+	}
+	return false;
+}
+
+bool ObtDevice::checkOptionalDeviceExtensionSupport(VkPhysicalDevice device, const char *extensionName) {
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+	for (const auto &extension : availableExtensions) {
+		if (strcmp(extension.extensionName, extensionName) == 0) return true;
+	}
+	return false;
+}
+
 QueueFamilyIndices ObtDevice::findQueueFamilies(VkPhysicalDevice device) {
 	QueueFamilyIndices indices;
 
@@ -348,31 +432,30 @@ SwapChainSupportDetails ObtDevice::querySwapChainSupport(VkPhysicalDevice device
 
 VkFormat ObtDevice::findSupportedFormat(const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
 	for (VkFormat format : candidates) {
-		VkFormatProperties props;
-		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
-
-		if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features) {
-			return format;
-		} else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features) {
+		if (isFormatSupported(format, tiling, features)) {
 			return format;
 		}
 	}
 	throw std::runtime_error("failed to find supported format!");
 }
 
-uint32_t ObtDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-	VkPhysicalDeviceMemoryProperties memProperties;
-	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-			return i;
-		}
+bool ObtDevice::isFormatSupported(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features) {
+	VkFormatProperties props;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+
+	if (tiling == VK_IMAGE_TILING_LINEAR) {
+		return (props.linearTilingFeatures & features) == features;
+	} else if (tiling == VK_IMAGE_TILING_OPTIMAL) {
+		return (props.optimalTilingFeatures & features) == features;
 	}
+	return false;
+}
 
-	throw std::runtime_error("failed to find suitable memory type!");
+uint32_t ObtDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+	return allocator->findMemoryType(typeFilter, properties);
 }
 
-void ObtDevice::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory) {
+void ObtDevice::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, ObtAllocation &bufferMemory) {
 	VkBufferCreateInfo bufferInfo{};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferInfo.size = size;
@@ -386,27 +469,51 @@ void ObtDevice::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemo
 	VkMemoryRequirements memRequirements;
 	vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+	ObtMemoryCategory category = ObtMemoryCategory::Other;
+	if (usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT)) {
+		category = ObtMemoryCategory::Geometry;
+	} else if (usage == VK_BUFFER_USAGE_TRANSFER_SRC_BIT) {
+		category = ObtMemoryCategory::Staging;
+	}
+
+	bufferMemory = allocator->allocate(memRequirements, properties, true, category);
 
-	if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate vertex buffer memory!");
+	if (vkBindBufferMemory(device_, buffer, bufferMemory.memory, bufferMemory.offset) != VK_SUCCESS) {
+		throw std::runtime_error("failed to bind buffer memory!");
 	}
+}
 
-	vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+void ObtDevice::destroyBuffer(VkBuffer buffer, ObtAllocation &bufferMemory) {
+	vkDestroyBuffer(device_, buffer, nullptr);
+	allocator->free(bufferMemory);
+}
+
+/**
+ * Waits for the device to go idle while holding the queue mutex, vkDeviceWaitIdle requires every
+ * queue of the device to be externally synchronized
+ */
+void ObtDevice::waitIdle() {
+	std::lock_guard<std::mutex> lock{queueMutex_};
+	vkDeviceWaitIdle(device_);
 }
 
 VkCommandBuffer ObtDevice::beginSingleTimeCommands() {
 	VkCommandBufferAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = commandPool;
+	allocInfo.commandPool = acquireCommandPool();
 	allocInfo.commandBufferCount = 1;
 
 	VkCommandBuffer commandBuffer;
-	vkAllocateCommandBuffers(device_, &allocInfo, &commandBuffer);
+	if (vkAllocateCommandBuffers(device_, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+		std::lock_guard<std::mutex> lock{commandPoolMutex};
+		freeCommandPools.push_back(allocInfo.commandPool);
+		throw std::runtime_error("failed to allocate single time command buffer!");
+	}
+	{
+		std::lock_guard<std::mutex> lock{commandPoolMutex};
+		singleTimeCommandPools.emplace(commandBuffer, allocInfo.commandPool);
+	}
 
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -424,18 +531,26 @@ void ObtDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
 
-	vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(graphicsQueue_);
+	{
+		std::lock_guard<std::mutex> lock{queueMutex_};
+		vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
+		vkQueueWaitIdle(graphicsQueue_);
+	}
 
-	vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
+	std::lock_guard<std::mutex> lock{commandPoolMutex};
+	auto singleTimeCommandPool = singleTimeCommandPools.find(commandBuffer);
+	assert(singleTimeCommandPool != singleTimeCommandPools.end() && "Command buffer was not begun with beginSingleTimeCommands");
+	vkFreeCommandBuffers(device_, singleTimeCommandPool->second, 1, &commandBuffer);
+	freeCommandPools.push_back(singleTimeCommandPool->second);
+	singleTimeCommandPools.erase(singleTimeCommandPool);
 }
 
-void ObtDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
+void ObtDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset, VkDeviceSize dstOffset) {
 	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
 	VkBufferCopy copyRegion{};
-	copyRegion.srcOffset = 0;	// Optional
-	copyRegion.dstOffset = 0;	// Optional
+	copyRegion.srcOffset = srcOffset;
+	copyRegion.dstOffset = dstOffset;
 	copyRegion.size = size;
 	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
@@ -462,7 +577,7 @@ void ObtDevice::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width
 	endSingleTimeCommands(commandBuffer);
 }
 
-void ObtDevice::createImageWithInfo(const VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties, VkImage &image, VkDeviceMemory &imageMemory) {
+void ObtDevice::createImageWithInfo(const VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties, VkImage &image, ObtAllocation &imageMemory) {
 	if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create image!");
 	}
@@ -470,18 +585,156 @@ void ObtDevice::createImageWithInfo(const VkImageCreateInfo &imageInfo, VkMemory
 	VkMemoryRequirements memRequirements;
 	vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-	if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate image memory!");
+	ObtMemoryCategory category = ObtMemoryCategory::Texture;
+	if (imageInfo.usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) {
+		category = ObtMemoryCategory::Attachment;
 	}
 
-	if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
+	imageMemory = allocator->allocate(memRequirements, properties, imageInfo.tiling == VK_IMAGE_TILING_LINEAR, category);
+
+	if (vkBindImageMemory(device_, image, imageMemory.memory, imageMemory.offset) != VK_SUCCESS) {
 		throw std::runtime_error("failed to bind image memory!");
 	}
 }
 
+void ObtDevice::destroyImage(VkImage image, ObtAllocation &imageMemory) {
+	vkDestroyImage(device_, image, nullptr);
+	allocator->free(imageMemory);
+}
+
+/**
+ * Records a copy of a device local buffer into a new allocation and swaps the handles over
+ *
+ * @note The buffer needs VK_BUFFER_USAGE_TRANSFER_SRC_BIT, the caller is responsible for the
+ * barrier between the copy and the next read
+ *
+ * @param retired Receives the old buffer and memory for deferred destruction
+ */
+void ObtDevice::relocateBuffer(VkCommandBuffer commandBuffer, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, ObtAllocation &bufferMemory, ObtRetiredResource &retired) {
+	VkBuffer newBuffer;
+	ObtAllocation newMemory;
+	createBuffer(size, usage, properties, newBuffer, newMemory);
+
+	VkBufferCopy copyRegion{};
+	copyRegion.size = size;
+	vkCmdCopyBuffer(commandBuffer, buffer, newBuffer, 1, &copyRegion);
+
+	retired.buffer = buffer;
+	retired.allocation = bufferMemory;
+	buffer = newBuffer;
+	bufferMemory = newMemory;
+}
+
+/**
+ * Records a copy of every mip level and layer of a sampled color image into a new allocation and
+ * swaps the handles over, the new image ends up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+ *
+ * @note The image needs VK_IMAGE_USAGE_TRANSFER_SRC_BIT. Views of the old image are not
+ * recreated.
+ *
+ * @param retired Receives the old image and memory for deferred destruction
+ */
+void ObtDevice::relocateImage(VkCommandBuffer commandBuffer, const VkImageCreateInfo &imageInfo, VkImage &image, ObtAllocation &imageMemory, ObtRetiredResource &retired) {
+	VkImage newImage;
+	ObtAllocation newMemory;
+	createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, newImage, newMemory);
+
+	std::array<VkImageMemoryBarrier, 2> barriers{};
+	for (auto &barrier : barriers) {
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = imageInfo.mipLevels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = imageInfo.arrayLayers;
+	}
+	barriers[0].image = image;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barriers[1].image = newImage;
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[1].srcAccessMask = 0;
+	barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+	std::vector<VkImageCopy> regions(imageInfo.mipLevels);
+	for (uint32_t i = 0; i < imageInfo.mipLevels; i++) {
+		VkImageSubresourceLayers subresource{VK_IMAGE_ASPECT_COLOR_BIT, i, 0, imageInfo.arrayLayers};
+		regions[i].srcSubresource = subresource;
+		regions[i].dstSubresource = subresource;
+		regions[i].extent = {std::max(imageInfo.extent.width >> i, 1u), std::max(imageInfo.extent.height >> i, 1u), 1};
+	}
+	vkCmdCopyImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barriers[1]);
+
+	retired.image = image;
+	retired.allocation = imageMemory;
+	image = newImage;
+	imageMemory = newMemory;
+}
+
+void ObtDevice::destroyRetired(ObtRetiredResource &retired) {
+	if (retired.imageView != VK_NULL_HANDLE) vkDestroyImageView(device_, retired.imageView, nullptr);
+	if (retired.image != VK_NULL_HANDLE) destroyImage(retired.image, retired.allocation);
+	if (retired.buffer != VK_NULL_HANDLE) destroyBuffer(retired.buffer, retired.allocation);
+	retired = ObtRetiredResource{};
+}
+
+void ObtDevice::registerRelocatable(ObtRelocatable *resource) {
+	std::lock_guard<std::mutex> lock{relocatablesMutex_};
+	relocatables.push_back(resource);
+}
+
+void ObtDevice::unregisterRelocatable(ObtRelocatable *resource) {
+	std::lock_guard<std::mutex> lock{relocatablesMutex_};
+	relocatables.erase(std::remove(relocatables.begin(), relocatables.end(), resource), relocatables.end());
+}
+
+std::vector<ObtAllocator::HeapBudget> ObtDevice::getMemoryBudget() {
+	auto budgets = allocator->getHeapBudgets();
+	if (!memoryBudgetSupported) return budgets;
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	VkPhysicalDeviceMemoryProperties2KHR memoryProperties{};
+	memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+	memoryProperties.pNext = &budgetProperties;
+	getPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties);
+
+	for (size_t i = 0; i < budgets.size(); i++) {
+		budgets[i].budget = budgetProperties.heapBudget[i];
+		budgets[i].usage = budgetProperties.heapUsage[i];
+	}
+	return budgets;
+}
+
+void ObtDevice::logMemoryBudget() {
+	constexpr double MB = 1024.0 * 1024.0;
+
+	auto budgets = getMemoryBudget();
+	for (size_t i = 0; i < budgets.size(); i++) {
+		auto &heap = budgets[i];
+		if (heap.reservedBytes == 0 && heap.usage == 0) continue;
+
+		std::cout << std::fixed << std::setprecision(1) << "memory heap " << i
+			<< ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local)" : "")
+			<< ": " << heap.usage / MB << "/" << heap.budget / MB << " MB used, " << heap.reservedBytes / MB << " MB reserved";
+		for (uint32_t c = 0; c < ObtAllocator::CATEGORY_COUNT; c++) {
+			std::cout << ", " << ObtAllocator::categoryName(static_cast<ObtMemoryCategory>(c)) << " " << heap.categoryBytes[c] / MB << " MB";
+		}
+		std::cout << std::defaultfloat << std::endl;
+	}
+}
+
 }
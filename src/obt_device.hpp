@@ -1,8 +1,12 @@
 #pragma once
 
 #include "obt_window.hpp"
+#include "obt_allocator.hpp"
 
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace obt {
@@ -37,24 +41,53 @@ class ObtDevice {
 		ObtDevice(ObtDevice &&) = delete;
 		ObtDevice &operator=(ObtDevice &&) = delete;
 
-		VkCommandPool getCommandPool() { return commandPool; }
 		VkDevice device() { return device_; }
 		VkSurfaceKHR surface() { return surface_; }
 		VkQueue graphicsQueue() { return graphicsQueue_; }
 		VkQueue presentQueue() { return presentQueue_; }
+		// Held around every submission and present, queues must not be used by two threads at once
+		std::mutex& queueMutex() { return queueMutex_; }
+		void waitIdle();
 
 		SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
 		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 		QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
 		VkFormat findSupportedFormat(const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+		bool isFormatSupported(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features);
 
-		void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory);
+		void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, ObtAllocation &bufferMemory);
+		void destroyBuffer(VkBuffer buffer, ObtAllocation &bufferMemory);
 		VkCommandBuffer beginSingleTimeCommands();
 		void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-		void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+		void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0);
 		void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 
-		void createImageWithInfo(const VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties, VkImage &image, VkDeviceMemory &imageMemory);
+		void createImageWithInfo(const VkImageCreateInfo &imageInfo, VkMemoryPropertyFlags properties, VkImage &image, ObtAllocation &imageMemory);
+		void destroyImage(VkImage image, ObtAllocation &imageMemory);
+
+		void relocateBuffer(VkCommandBuffer commandBuffer, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, ObtAllocation &bufferMemory, ObtRetiredResource &retired);
+		void relocateImage(VkCommandBuffer commandBuffer, const VkImageCreateInfo &imageInfo, VkImage &image, ObtAllocation &imageMemory, ObtRetiredResource &retired);
+		void destroyRetired(ObtRetiredResource &retired);
+
+		// Resources are created and destroyed from any thread, hold relocatablesMutex() while
+		// iterating getRelocatables() so none of them is destroyed under the loop
+		void registerRelocatable(ObtRelocatable *resource);
+		void unregisterRelocatable(ObtRelocatable *resource);
+		std::mutex &relocatablesMutex() { return relocatablesMutex_; }
+		const std::vector<ObtRelocatable *> &getRelocatables() const { return relocatables; }
+
+		ObtAllocator &getAllocator() { return *allocator; }
+		ObtAllocator::Stats getMemoryStats() { return allocator->getStats(); }
+		std::vector<ObtAllocator::HeapBudget> getMemoryBudget();
+		void logMemoryBudget();
+		bool isMemoryBudgetSupported() const { return memoryBudgetSupported; }
+
+		// Indirect draws with more than one command and with a first instance other than zero
+		bool isMultiDrawIndirectSupported() const { return multiDrawIndirectSupported; }
+		bool isDrawIndirectCountSupported() const { return cmdDrawIndexedIndirectCount != nullptr; }
+		void drawIndexedIndirectCount(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countBufferOffset, uint32_t maxDrawCount, uint32_t stride) {
+			cmdDrawIndexedIndirectCount(commandBuffer, buffer, offset, countBuffer, countBufferOffset, maxDrawCount, stride);
+		}
 
 		VkPhysicalDeviceProperties properties;
 
@@ -64,7 +97,8 @@ class ObtDevice {
 		void createSurface();
 		void pickPhysicalDevice();
 		void createLogicalDevice();
-		void createCommandPool();
+		VkCommandPool acquireCommandPool();
+		void createAllocator();
 
 		bool isDeviceSuitable(VkPhysicalDevice device);
 		std::vector<const char *> getRequiredExtensions();
@@ -73,19 +107,34 @@ class ObtDevice {
 		void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
 		void hasGflwRequiredInstanceExtensions();
 		bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+		bool checkInstanceExtensionSupport(const char *extensionName);
+		bool checkOptionalDeviceExtensionSupport(VkPhysicalDevice device, const char *extensionName);
 		SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
 		VkInstance instance;
 		VkDebugUtilsMessengerEXT debugMessenger;
 		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 		ObtWindow &window;
-		VkCommandPool commandPool;
+		// Every single time command buffer has a pool to itself until it ends, the pool then goes
+		// back to the free list, so there are only as many pools as concurrent recordings
+		std::mutex commandPoolMutex;
+		std::vector<VkCommandPool> freeCommandPools;
+		std::unordered_map<VkCommandBuffer, VkCommandPool> singleTimeCommandPools;
+		std::mutex queueMutex_;
+		std::unique_ptr<ObtAllocator> allocator;
+		std::mutex relocatablesMutex_;
+		std::vector<ObtRelocatable *> relocatables;
 
 		VkDevice device_;
 		VkSurfaceKHR surface_;
 		VkQueue graphicsQueue_;
 		VkQueue presentQueue_;
 
+		bool memoryBudgetSupported = false;
+		bool multiDrawIndirectSupported = false;
+		PFN_vkGetPhysicalDeviceMemoryProperties2KHR getPhysicalDeviceMemoryProperties2 = nullptr;
+		PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+
 		const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
 		const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME, "VK_KHR_shader_draw_parameters"};
 	};
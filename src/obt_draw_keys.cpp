@@ -0,0 +1,111 @@
+#include "obt_draw_keys.hpp"
+
+#include <array>
+#include <utility>
+
+namespace obt {
+
+/**
+ * Quantizes a view space depth into a draw key depth bucket, nearer depths get smaller buckets
+ *
+ * @param depth Distance along the view direction, clamped to [0, maxDepth]
+ * @param maxDepth Depth mapped to the last bucket, usually the far plane
+ */
+uint32_t depthToBucket(float depth, float maxDepth) {
+	constexpr uint32_t lastBucket = (1u << DRAW_KEY_DEPTH_BITS) - 1;
+	if (!(depth > 0.f) || maxDepth <= 0.f) return 0;
+	if (depth >= maxDepth) return lastBucket;
+	return static_cast<uint32_t>(depth / maxDepth * static_cast<float>(lastBucket));
+}
+
+/**
+ * Stable least significant digit radix sort on the keys, a byte per pass. The histograms of all eight
+ * bytes are counted in one read of the items, and passes over bytes every key agrees on are skipped,
+ * so keys with mostly constant fields only pay for the bytes that actually vary.
+ *
+ * @param scratch Reused between calls, resized to the item count
+ */
+void radixSortDrawItems(std::vector<ObtDrawItem>& items, std::vector<ObtDrawItem>& scratch) {
+	size_t count = items.size();
+	if (count < 2) return;
+	scratch.resize(count);
+
+	std::array<std::array<uint32_t, 256>, 8> histograms{};
+	for (const auto& item : items) {
+		for (uint32_t digit = 0; digit < 8; digit++) {
+			histograms[digit][(item.key >> (digit * 8)) & 0xff]++;
+		}
+	}
+
+	ObtDrawItem* source = items.data();
+	ObtDrawItem* destination = scratch.data();
+	for (uint32_t digit = 0; digit < 8; digit++) {
+		uint32_t shift = digit * 8;
+		auto& histogram = histograms[digit];
+		if (histogram[(source[0].key >> shift) & 0xff] == count) continue;
+
+		uint32_t offset = 0;
+		for (auto& bucket : histogram) {
+			uint32_t bucketCount = bucket;
+			bucket = offset;
+			offset += bucketCount;
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			const ObtDrawItem& item = source[i];
+			destination[histogram[(item.key >> shift) & 0xff]++] = item;
+		}
+		std::swap(source, destination);
+	}
+
+	if (source != items.data()) items.swap(scratch);
+}
+
+void ObtDrawState::bindPipeline(ObtPipeline* pipeline) {
+	if (pipeline == boundPipeline) {
+		skippedBindCount++;
+		return;
+	}
+	pipeline->bind(commandBuffer);
+	boundPipeline = pipeline;
+	bindCount++;
+}
+
+void ObtDrawState::bindDescriptorSets(VkPipelineLayout layout, uint32_t firstSet, const std::vector<VkDescriptorSet>& descriptorSets, const std::vector<uint32_t>& dynamicOffsets) {
+	if (layout == boundLayout && firstSet == boundFirstSet && descriptorSets == boundSets && dynamicOffsets == boundOffsets) {
+		skippedBindCount++;
+		return;
+	}
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, firstSet,
+		static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(),
+		static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+	boundLayout = layout;
+	boundFirstSet = firstSet;
+	boundSets = descriptorSets;
+	boundOffsets = dynamicOffsets;
+	bindCount++;
+}
+
+void ObtDrawState::bindModel(ObtModel* model) {
+	if (model == boundModel) {
+		skippedBindCount++;
+		return;
+	}
+	model->bind(commandBuffer);
+	boundModel = model;
+	boundGeometryPool = nullptr;
+	bindCount++;
+}
+
+void ObtDrawState::bindGeometryPool(ObtGeometryPool* geometryPool) {
+	if (geometryPool == boundGeometryPool) {
+		skippedBindCount++;
+		return;
+	}
+	geometryPool->bind(commandBuffer);
+	boundGeometryPool = geometryPool;
+	boundModel = nullptr;
+	bindCount++;
+}
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "obt_pipeline.hpp"
+#include "obt_model.hpp"
+#include "obt_geometry_pool.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+namespace obt {
+
+// Draws are ordered by 64 bit keys that pack, from the most significant bits down, the pass,
+// pipeline, material, model and a depth bucket. Sorting the keys groups draws by the state that is
+// most expensive to change, and draws that share everything but their depth end up next to each
+// other, ordered front to back, ready to be drawn as one instanced draw.
+static constexpr uint32_t DRAW_KEY_PASS_BITS = 4;
+static constexpr uint32_t DRAW_KEY_PIPELINE_BITS = 8;
+static constexpr uint32_t DRAW_KEY_MATERIAL_BITS = 16;
+static constexpr uint32_t DRAW_KEY_MODEL_BITS = 20;
+static constexpr uint32_t DRAW_KEY_DEPTH_BITS = 16;
+static_assert(DRAW_KEY_PASS_BITS + DRAW_KEY_PIPELINE_BITS + DRAW_KEY_MATERIAL_BITS + DRAW_KEY_MODEL_BITS + DRAW_KEY_DEPTH_BITS == 64);
+
+static constexpr uint32_t DRAW_KEY_MODEL_SHIFT = DRAW_KEY_DEPTH_BITS;
+static constexpr uint32_t DRAW_KEY_MATERIAL_SHIFT = DRAW_KEY_MODEL_SHIFT + DRAW_KEY_MODEL_BITS;
+static constexpr uint32_t DRAW_KEY_PIPELINE_SHIFT = DRAW_KEY_MATERIAL_SHIFT + DRAW_KEY_MATERIAL_BITS;
+static constexpr uint32_t DRAW_KEY_PASS_SHIFT = DRAW_KEY_PIPELINE_SHIFT + DRAW_KEY_PIPELINE_BITS;
+
+// Keys equal under this mask draw with the same state
+static constexpr uint64_t DRAW_KEY_STATE_MASK = ~((uint64_t{1} << DRAW_KEY_DEPTH_BITS) - 1);
+
+inline uint64_t makeDrawKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t model, uint32_t depthBucket) {
+	assert(pass < (1u << DRAW_KEY_PASS_BITS) && "Pass does not fit in a draw key!");
+	assert(pipeline < (1u << DRAW_KEY_PIPELINE_BITS) && "Pipeline does not fit in a draw key!");
+	assert(material < (1u << DRAW_KEY_MATERIAL_BITS) && "Material does not fit in a draw key!");
+	assert(model < (1u << DRAW_KEY_MODEL_BITS) && "Model does not fit in a draw key!");
+	assert(depthBucket < (1u << DRAW_KEY_DEPTH_BITS) && "Depth bucket does not fit in a draw key!");
+	return (uint64_t{pass} << DRAW_KEY_PASS_SHIFT) | (uint64_t{pipeline} << DRAW_KEY_PIPELINE_SHIFT) |
+		(uint64_t{material} << DRAW_KEY_MATERIAL_SHIFT) | (uint64_t{model} << DRAW_KEY_MODEL_SHIFT) | depthBucket;
+}
+
+inline uint32_t drawKeyPass(uint64_t key) { return static_cast<uint32_t>(key >> DRAW_KEY_PASS_SHIFT) & ((1u << DRAW_KEY_PASS_BITS) - 1); }
+inline uint32_t drawKeyPipeline(uint64_t key) { return static_cast<uint32_t>(key >> DRAW_KEY_PIPELINE_SHIFT) & ((1u << DRAW_KEY_PIPELINE_BITS) - 1); }
+inline uint32_t drawKeyMaterial(uint64_t key) { return static_cast<uint32_t>(key >> DRAW_KEY_MATERIAL_SHIFT) & ((1u << DRAW_KEY_MATERIAL_BITS) - 1); }
+inline uint32_t drawKeyModel(uint64_t key) { return static_cast<uint32_t>(key >> DRAW_KEY_MODEL_SHIFT) & ((1u << DRAW_KEY_MODEL_BITS) - 1); }
+
+uint32_t depthToBucket(float depth, float maxDepth);
+
+struct ObtDrawItem {
+	uint64_t key;
+	uint32_t objectIndex;
+};
+
+void radixSortDrawItems(std::vector<ObtDrawItem>& items, std::vector<ObtDrawItem>& scratch);
+
+// Remembers what was last bound to a command buffer, so recording sorted draws skips binds that
+// would not change anything
+class ObtDrawState {
+	public:
+		ObtDrawState(VkCommandBuffer commandBuffer) : commandBuffer{commandBuffer} {}
+
+		ObtDrawState(const ObtDrawState&) = delete;
+		ObtDrawState &operator=(const ObtDrawState&) = delete;
+
+		void bindPipeline(ObtPipeline* pipeline);
+		void bindDescriptorSets(VkPipelineLayout layout, uint32_t firstSet, const std::vector<VkDescriptorSet>& descriptorSets, const std::vector<uint32_t>& dynamicOffsets);
+		void bindModel(ObtModel* model);
+		void bindGeometryPool(ObtGeometryPool* geometryPool);
+
+		uint32_t getBindCount() const { return bindCount; }
+		uint32_t getSkippedBindCount() const { return skippedBindCount; }
+
+	private:
+		VkCommandBuffer commandBuffer;
+		ObtPipeline* boundPipeline = nullptr;
+		VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+		uint32_t boundFirstSet = 0;
+		std::vector<VkDescriptorSet> boundSets;
+		std::vector<uint32_t> boundOffsets;
+		// Models and geometry pools bind the same vertex and index bindings, at most one is bound
+		ObtModel* boundModel = nullptr;
+		ObtGeometryPool* boundGeometryPool = nullptr;
+
+		uint32_t bindCount = 0;
+		uint32_t skippedBindCount = 0;
+};
+
+}
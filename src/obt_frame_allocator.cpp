@@ -0,0 +1,97 @@
+#include "obt_frame_allocator.hpp"
+
+#include "obt_swap_chain.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <numeric>
+
+namespace obt {
+
+ObtFrameAllocator::ObtFrameAllocator(ObtDevice& obtDevice, VkDeviceSize frameSize, VkBufferUsageFlags usageFlags) : obtDevice{obtDevice}, usageFlags{usageFlags} {
+	auto& limits = obtDevice.properties.limits;
+	alignment = std::lcm(std::lcm(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment), limits.nonCoherentAtomSize);
+
+	frames.resize(ObtSwapChain::MAX_FRAMES_IN_FLIGHT);
+	for (auto& frame : frames) {
+		frame.buffer = createBuffer(frameSize);
+	}
+}
+
+/**
+ * @note The size is rounded up to the alignment, allocate() aligns the head past every slice and it
+ * must not end up behind the end of the buffer
+ */
+std::unique_ptr<ObtBuffer> ObtFrameAllocator::createBuffer(VkDeviceSize size) {
+	size = (std::max(size, VkDeviceSize{1}) + alignment - 1) / alignment * alignment;
+	auto buffer = std::make_unique<ObtBuffer>(obtDevice, size, 1, usageFlags, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	buffer->map();
+	return buffer;
+}
+
+/**
+ * Starts handing out memory for a frame, must only be called once the fence of that frame has been
+ * waited on since everything allocated the last time the frame was used is overwritten
+ *
+ * @param frameIndex Index of the frame in flight
+ */
+void ObtFrameAllocator::beginFrame(int frameIndex) {
+	assert(frameIndex < frames.size() && "Frame index out of range");
+	this->frameIndex = frameIndex;
+	frames[frameIndex].head = 0;
+	frames[frameIndex].retired.clear();
+}
+
+/**
+ * Allocates a slice of the current frame's buffer, aligned for use as a dynamic uniform or storage
+ * buffer offset
+ *
+ * @note Growing the buffer copies what was already written, so write each allocation before
+ * requesting the next one. Descriptor sets pointing at the frame must be rewritten when its
+ * generation changes.
+ *
+ * @param size Size of the slice in bytes
+ *
+ * @return The slice, data points to its mapped memory and offset is the dynamic offset to bind
+ */
+ObtFrameAllocator::Allocation ObtFrameAllocator::allocate(VkDeviceSize size) {
+	Frame& frame = frames[frameIndex];
+	VkDeviceSize offset = frame.head;
+	if (offset + size > frame.buffer->getBufferSize()) {
+		grow(offset + size);
+	}
+	frame.head = (offset + size + alignment - 1) / alignment * alignment;
+
+	Allocation allocation{};
+	allocation.data = static_cast<char*>(frame.buffer->getMappedMemory()) + offset;
+	allocation.buffer = frame.buffer->getBuffer();
+	allocation.offset = static_cast<uint32_t>(offset);
+	allocation.size = size;
+	return allocation;
+}
+
+void ObtFrameAllocator::grow(VkDeviceSize minSize) {
+	Frame& frame = frames[frameIndex];
+	VkDeviceSize newSize = std::max(frame.buffer->getBufferSize() * 2, minSize);
+
+	auto buffer = createBuffer(newSize);
+	std::memcpy(buffer->getMappedMemory(), frame.buffer->getMappedMemory(), frame.head);
+
+	// The old buffer may still be referenced by descriptor sets until they are rewritten
+	frame.retired.push_back(std::move(frame.buffer));
+	frame.buffer = std::move(buffer);
+	frame.generation++;
+}
+
+/**
+ * Flushes everything allocated in the current frame so far
+ */
+void ObtFrameAllocator::flush() {
+	Frame& frame = frames[frameIndex];
+	if (frame.head > 0) {
+		frame.buffer->flush(std::min(frame.head, frame.buffer->getBufferSize()), 0);
+	}
+}
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "obt_device.hpp"
+#include "obt_buffer.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace obt {
+
+// Persistently mapped bump allocator for data that only lives for one frame, with one buffer per
+// frame in flight that is reset once that frame's fence has been waited on
+class ObtFrameAllocator {
+	public:
+		static constexpr VkDeviceSize DEFAULT_FRAME_SIZE = 64 * 1024;
+
+		struct Allocation {
+			void* data = nullptr;
+			VkBuffer buffer = VK_NULL_HANDLE;
+			uint32_t offset = 0;
+			VkDeviceSize size = 0;
+		};
+
+		ObtFrameAllocator(ObtDevice& obtDevice, VkDeviceSize frameSize = DEFAULT_FRAME_SIZE, VkBufferUsageFlags usageFlags = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+		ObtFrameAllocator(const ObtFrameAllocator&) = delete;
+		ObtFrameAllocator &operator=(const ObtFrameAllocator&) = delete;
+
+		void beginFrame(int frameIndex);
+		Allocation allocate(VkDeviceSize size);
+		void flush();
+
+		template<typename T>
+		T* allocate(uint32_t count, Allocation& allocation) {
+			allocation = allocate(sizeof(T) * count);
+			return static_cast<T*>(allocation.data);
+		}
+
+		VkDescriptorBufferInfo descriptorInfo(int frameIndex, VkDeviceSize size = VK_WHOLE_SIZE) { return frames[frameIndex].buffer->descriptorInfo(size, 0); }
+		uint32_t getGeneration(int frameIndex) const { return frames[frameIndex].generation; }
+		VkDeviceSize getUsedBytes() const { return frames[frameIndex].head; }
+		VkDeviceSize getAlignment() const { return alignment; }
+
+	private:
+		struct Frame {
+			std::unique_ptr<ObtBuffer> buffer;
+			std::vector<std::unique_ptr<ObtBuffer>> retired;
+			VkDeviceSize head = 0;
+			uint32_t generation = 0;
+		};
+
+		std::unique_ptr<ObtBuffer> createBuffer(VkDeviceSize size);
+		void grow(VkDeviceSize minSize);
+
+		ObtDevice& obtDevice;
+		VkBufferUsageFlags usageFlags;
+		VkDeviceSize alignment;
+
+		std::vector<Frame> frames;
+		int frameIndex = 0;
+};
+
+}
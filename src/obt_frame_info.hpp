@@ -13,7 +13,10 @@ struct FrameInfo {
 	VkCommandBuffer commandBuffer;
 	ObtCamera& camera;
 	std::vector<VkDescriptorSet>& descriptorSets;
-	uint32_t dynamicOffsets;
+	std::vector<uint32_t>& dynamicOffsets;
+	// Increases whenever a descriptor set was rewritten or a resource was moved, commands recorded
+	// in an earlier frame are stale once it changed
+	uint64_t resourceVersion = 0;
 };
 
 }
@@ -0,0 +1,176 @@
+#include "obt_frustum_culling.hpp"
+
+#include "obt_job_system.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define OBT_FRUSTUM_CULLING_X86
+#include <immintrin.h>
+#endif
+
+namespace obt {
+
+static bool sphereVisible(const ObtFrustumPlanes& planes, const glm::vec4& sphere) {
+	for (const auto& plane : planes) {
+		if (plane.x * sphere.x + plane.y * sphere.y + plane.z * sphere.z + plane.w <= -sphere.w) return false;
+	}
+	return true;
+}
+
+static bool hasFlags(const uint32_t* flags, uint32_t index, uint32_t requiredFlags) {
+	return flags == nullptr || (flags[index] & requiredFlags) == requiredFlags;
+}
+
+// Appends the indices of the set bits of a lane mask that also pass the flag test
+static uint32_t appendVisible(int mask, uint32_t base, const uint32_t* flags, uint32_t requiredFlags, uint32_t* visible) {
+	uint32_t written = 0;
+	while (mask != 0) {
+		uint32_t lane = static_cast<uint32_t>(__builtin_ctz(mask));
+		mask &= mask - 1;
+		if (hasFlags(flags, base + lane, requiredFlags)) {
+			visible[written++] = base + lane;
+		}
+	}
+	return written;
+}
+
+#ifdef OBT_FRUSTUM_CULLING_X86
+
+__attribute__((target("sse2")))
+static uint32_t cullSse2(const ObtFrustumPlanes& planes, const glm::vec4* spheres, const uint32_t* flags, uint32_t requiredFlags,
+	uint32_t begin, uint32_t end, uint32_t* visible) {
+	__m128 plane[6][4];
+	for (int p = 0; p < 6; p++) {
+		for (int c = 0; c < 4; c++) {
+			plane[p][c] = _mm_set1_ps(planes[p][c]);
+		}
+	}
+	const __m128 signMask = _mm_set1_ps(-0.f);
+
+	uint32_t written = 0;
+	uint32_t i = begin;
+	for (; i + 4 <= end; i += 4) {
+		__m128 x = _mm_loadu_ps(&spheres[i].x);
+		__m128 y = _mm_loadu_ps(&spheres[i + 1].x);
+		__m128 z = _mm_loadu_ps(&spheres[i + 2].x);
+		__m128 r = _mm_loadu_ps(&spheres[i + 3].x);
+		_MM_TRANSPOSE4_PS(x, y, z, r);
+		__m128 negativeRadius = _mm_xor_ps(r, signMask);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane[p][0], x), _mm_mul_ps(plane[p][1], y)), _mm_add_ps(_mm_mul_ps(plane[p][2], z), plane[p][3]));
+			inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, negativeRadius));
+		}
+
+		written += appendVisible(_mm_movemask_ps(inside), i, flags, requiredFlags, visible + written);
+	}
+
+	for (; i < end; i++) {
+		if (sphereVisible(planes, spheres[i]) && hasFlags(flags, i, requiredFlags)) visible[written++] = i;
+	}
+	return written;
+}
+
+__attribute__((target("avx")))
+static uint32_t cullAvx(const ObtFrustumPlanes& planes, const glm::vec4* spheres, const uint32_t* flags, uint32_t requiredFlags,
+	uint32_t begin, uint32_t end, uint32_t* visible) {
+	__m256 plane[6][4];
+	for (int p = 0; p < 6; p++) {
+		for (int c = 0; c < 4; c++) {
+			plane[p][c] = _mm256_set1_ps(planes[p][c]);
+		}
+	}
+	const __m256 signMask = _mm256_set1_ps(-0.f);
+
+	uint32_t written = 0;
+	uint32_t i = begin;
+	for (; i + 8 <= end; i += 8) {
+		// Spheres i..i+3 go to the low and i+4..i+7 to the high half, a 4x4 transpose within each
+		// half then leaves one component per register
+		__m256 s0 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&spheres[i].x)), _mm_loadu_ps(&spheres[i + 4].x), 1);
+		__m256 s1 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&spheres[i + 1].x)), _mm_loadu_ps(&spheres[i + 5].x), 1);
+		__m256 s2 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&spheres[i + 2].x)), _mm_loadu_ps(&spheres[i + 6].x), 1);
+		__m256 s3 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&spheres[i + 3].x)), _mm_loadu_ps(&spheres[i + 7].x), 1);
+		__m256 t0 = _mm256_unpacklo_ps(s0, s1);
+		__m256 t1 = _mm256_unpackhi_ps(s0, s1);
+		__m256 t2 = _mm256_unpacklo_ps(s2, s3);
+		__m256 t3 = _mm256_unpackhi_ps(s2, s3);
+		__m256 x = _mm256_shuffle_ps(t0, t2, 0x44);
+		__m256 y = _mm256_shuffle_ps(t0, t2, 0xEE);
+		__m256 z = _mm256_shuffle_ps(t1, t3, 0x44);
+		__m256 r = _mm256_shuffle_ps(t1, t3, 0xEE);
+		__m256 negativeRadius = _mm256_xor_ps(r, signMask);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(plane[p][0], x), _mm256_mul_ps(plane[p][1], y)), _mm256_add_ps(_mm256_mul_ps(plane[p][2], z), plane[p][3]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GT_OQ));
+		}
+
+		// Lanes come out as 0-3 in the low and 4-7 in the high half, matching sphere order
+		written += appendVisible(_mm256_movemask_ps(inside), i, flags, requiredFlags, visible + written);
+	}
+
+	return written + cullSse2(planes, spheres, flags, requiredFlags, i, end, visible + written);
+}
+
+using CullFn = uint32_t (*)(const ObtFrustumPlanes&, const glm::vec4*, const uint32_t*, uint32_t, uint32_t, uint32_t, uint32_t*);
+
+static CullFn selectCull() {
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx") ? cullAvx : cullSse2;
+}
+
+#endif
+
+/**
+ * Culls the spheres in [begin, end)
+ *
+ * @param visible Receives the visible indices, needs room for end - begin entries
+ *
+ * @return Number of visible indices written
+ */
+uint32_t cullSpheres(const ObtFrustumPlanes& planes, const glm::vec4* spheres, const uint32_t* flags, uint32_t requiredFlags,
+	uint32_t begin, uint32_t end, uint32_t* visible) {
+#ifdef OBT_FRUSTUM_CULLING_X86
+	static const CullFn cull = selectCull();
+	return cull(planes, spheres, flags, requiredFlags, begin, end, visible);
+#else
+	uint32_t written = 0;
+	for (uint32_t i = begin; i < end; i++) {
+		if (sphereVisible(planes, spheres[i]) && hasFlags(flags, i, requiredFlags)) visible[written++] = i;
+	}
+	return written;
+#endif
+}
+
+/**
+ * Culls count spheres into a compact list of visible indices, with a job system large inputs are
+ * split into chunks that are culled in parallel and then packed together in order
+ */
+void cullSpheres(const ObtFrustumPlanes& planes, const glm::vec4* spheres, const uint32_t* flags, uint32_t requiredFlags,
+	uint32_t count, std::vector<uint32_t>& visible, ObtJobSystem* jobSystem) {
+	visible.resize(count);
+	if (jobSystem == nullptr || count <= CULL_GRAIN_SIZE) {
+		visible.resize(cullSpheres(planes, spheres, flags, requiredFlags, 0, count, visible.data()));
+		return;
+	}
+
+	// Every chunk writes to its own part of the list, the gaps are closed afterwards
+	uint32_t chunkCount = (count + CULL_GRAIN_SIZE - 1) / CULL_GRAIN_SIZE;
+	std::vector<uint32_t> chunkVisible(chunkCount);
+	jobSystem->parallelFor(count, CULL_GRAIN_SIZE, [&](uint32_t begin, uint32_t end) {
+		chunkVisible[begin / CULL_GRAIN_SIZE] = cullSpheres(planes, spheres, flags, requiredFlags, begin, end, visible.data() + begin);
+	});
+
+	uint32_t written = chunkVisible[0];
+	for (uint32_t chunk = 1; chunk < chunkCount; chunk++) {
+		std::memmove(visible.data() + written, visible.data() + chunk * CULL_GRAIN_SIZE, sizeof(uint32_t) * chunkVisible[chunk]);
+		written += chunkVisible[chunk];
+	}
+	visible.resize(written);
+}
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace obt {
+
+class ObtJobSystem;
+
+using ObtFrustumPlanes = std::array<glm::vec4, 6>;
+
+static constexpr uint32_t CULL_GRAIN_SIZE = 4096;
+
+// Tests bounding spheres (center in xyz, radius in w) against frustum planes, several spheres per
+// SIMD register. Objects whose flags lack any of requiredFlags are rejected as well, so the result
+// is the complete list of objects to draw, a null flags array skips that test. Visible indices are
+// written in ascending order.
+uint32_t cullSpheres(const ObtFrustumPlanes& planes, const glm::vec4* spheres, const uint32_t* flags, uint32_t requiredFlags,
+	uint32_t begin, uint32_t end, uint32_t* visible);
+
+void cullSpheres(const ObtFrustumPlanes& planes, const glm::vec4* spheres, const uint32_t* flags, uint32_t requiredFlags,
+	uint32_t count, std::vector<uint32_t>& visible, ObtJobSystem* jobSystem = nullptr);
+
+}
@@ -0,0 +1,82 @@
+#include "obt_geometry_pool.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace obt {
+
+static constexpr VkBufferUsageFlags VERTEX_USAGE = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+static constexpr VkBufferUsageFlags INDEX_USAGE = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+ObtGeometryPool::ObtGeometryPool(ObtDevice& obtDevice, VkDeviceSize vertexSize, uint32_t vertexCapacity, uint32_t indexCapacity)
+	: obtDevice{obtDevice}, vertexSize{vertexSize} {
+	vertexBuffer = createBuffer(vertexSize, std::max(vertexCapacity, 1u), VERTEX_USAGE);
+	indexBuffer = createBuffer(sizeof(uint32_t), std::max(indexCapacity, 1u), INDEX_USAGE);
+}
+
+std::unique_ptr<ObtBuffer> ObtGeometryPool::createBuffer(VkDeviceSize elementSize, uint32_t capacity, VkBufferUsageFlags usage) {
+	return std::make_unique<ObtBuffer>(obtDevice, elementSize, capacity, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+/**
+ * Grows a buffer by doubling until it holds requiredCount elements, the used part is copied over
+ *
+ * @note The copy waits for the graphics queue to go idle and the buffer handle changes, so only
+ * call between frames. The generation changes with it, so cached commands are recorded again.
+ */
+void ObtGeometryPool::reserve(std::unique_ptr<ObtBuffer>& buffer, VkDeviceSize elementSize, uint32_t usedCount, uint32_t requiredCount, VkBufferUsageFlags usage) {
+	uint32_t capacity = buffer->getInstanceCount();
+	if (requiredCount <= capacity) return;
+
+	while (capacity < requiredCount) capacity *= 2;
+	auto newBuffer = createBuffer(elementSize, capacity, usage);
+	if (usedCount > 0) obtDevice.copyBuffer(buffer->getBuffer(), newBuffer->getBuffer(), elementSize * usedCount);
+	buffer = std::move(newBuffer);
+	generation++;
+}
+
+void ObtGeometryPool::upload(ObtBuffer& buffer, const void* data, VkDeviceSize size, VkDeviceSize offset) {
+	ObtBuffer stagingBuffer{obtDevice, size, 1, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+	stagingBuffer.map();
+	stagingBuffer.writeToBuffer(const_cast<void*>(data));
+	obtDevice.copyBuffer(stagingBuffer.getBuffer(), buffer.getBuffer(), size, 0, offset);
+}
+
+/**
+ * Copies vertices to the end of the pool
+ *
+ * @return Index of the first vertex, the vertex offset of draws using them
+ */
+uint32_t ObtGeometryPool::addVertices(const void* vertices, uint32_t count) {
+	assert(count > 0 && "Cannot add empty vertex range!");
+	reserve(vertexBuffer, vertexSize, vertexCount, vertexCount + count, VERTEX_USAGE);
+	upload(*vertexBuffer, vertices, vertexSize * count, vertexSize * vertexCount);
+
+	uint32_t firstVertex = vertexCount;
+	vertexCount += count;
+	return firstVertex;
+}
+
+/**
+ * Copies indices to the end of the pool, indices stay relative to the vertex range they belong to
+ *
+ * @return Index of the first index, the first index of draws using them
+ */
+uint32_t ObtGeometryPool::addIndices(const uint32_t* indices, uint32_t count) {
+	assert(count > 0 && "Cannot add empty index range!");
+	reserve(indexBuffer, sizeof(uint32_t), indexCount, indexCount + count, INDEX_USAGE);
+	upload(*indexBuffer, indices, sizeof(uint32_t) * count, sizeof(uint32_t) * indexCount);
+
+	uint32_t firstIndex = indexCount;
+	indexCount += count;
+	return firstIndex;
+}
+
+void ObtGeometryPool::bind(VkCommandBuffer commandBuffer) {
+	VkBuffer buffers[] = {vertexBuffer->getBuffer()};
+	VkDeviceSize offsets[] = {0};
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "obt_device.hpp"
+#include "obt_buffer.hpp"
+
+#include <memory>
+
+namespace obt {
+
+// Device local vertex and index buffers shared by many models, so draws of different models can be
+// issued from one indirect buffer without rebinding geometry in between. Ranges are handed out front
+// to back and never freed, the pool is meant to be filled while loading.
+class ObtGeometryPool {
+	public:
+		static constexpr uint32_t DEFAULT_VERTEX_CAPACITY = 64 * 1024;
+		static constexpr uint32_t DEFAULT_INDEX_CAPACITY = 256 * 1024;
+
+		ObtGeometryPool(ObtDevice& obtDevice, VkDeviceSize vertexSize, uint32_t vertexCapacity = DEFAULT_VERTEX_CAPACITY, uint32_t indexCapacity = DEFAULT_INDEX_CAPACITY);
+
+		ObtGeometryPool(const ObtGeometryPool&) = delete;
+		ObtGeometryPool &operator=(const ObtGeometryPool&) = delete;
+
+		uint32_t addVertices(const void* vertices, uint32_t count);
+		uint32_t addIndices(const uint32_t* indices, uint32_t count);
+
+		// Binds both buffers from their start, draws address their ranges with vertex offset and first index
+		void bind(VkCommandBuffer commandBuffer);
+
+		VkBuffer getVertexBuffer() const { return vertexBuffer->getBuffer(); }
+		VkBuffer getIndexBuffer() const { return indexBuffer->getBuffer(); }
+		VkDeviceSize getVertexSize() const { return vertexSize; }
+		uint32_t getVertexCount() const { return vertexCount; }
+		uint32_t getIndexCount() const { return indexCount; }
+		// Changes whenever a buffer was reallocated, commands binding the old buffers are stale then
+		uint32_t getGeneration() const { return generation; }
+
+	private:
+		std::unique_ptr<ObtBuffer> createBuffer(VkDeviceSize elementSize, uint32_t capacity, VkBufferUsageFlags usage);
+		void reserve(std::unique_ptr<ObtBuffer>& buffer, VkDeviceSize elementSize, uint32_t usedCount, uint32_t requiredCount, VkBufferUsageFlags usage);
+		void upload(ObtBuffer& buffer, const void* data, VkDeviceSize size, VkDeviceSize offset);
+
+		ObtDevice& obtDevice;
+		VkDeviceSize vertexSize;
+
+		std::unique_ptr<ObtBuffer> vertexBuffer;
+		std::unique_ptr<ObtBuffer> indexBuffer;
+		uint32_t vertexCount = 0;
+		uint32_t indexCount = 0;
+		uint32_t generation = 0;
+};
+
+}
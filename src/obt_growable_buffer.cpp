@@ -0,0 +1,50 @@
+#include "obt_growable_buffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace obt {
+
+ObtGrowableBuffer::ObtGrowableBuffer(ObtDevice& obtDevice, VkDeviceSize elementSize, uint32_t initialCapacity, VkBufferUsageFlags usageFlags)
+	: obtDevice{obtDevice}, elementSize{elementSize}, usageFlags{usageFlags}, capacity{std::max(initialCapacity, 1u)} {
+	buffer = createBuffer(capacity);
+}
+
+std::unique_ptr<ObtBuffer> ObtGrowableBuffer::createBuffer(uint32_t capacity) {
+	if ((usageFlags & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) && elementSize * capacity > obtDevice.properties.limits.maxStorageBufferRange) {
+		throw std::runtime_error("Growable buffer exceeds maxStorageBufferRange!");
+	}
+
+	auto newBuffer = std::make_unique<ObtBuffer>(obtDevice, elementSize, capacity, usageFlags, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	newBuffer->map();
+	return newBuffer;
+}
+
+/**
+ * Makes sure the buffer can hold count elements, doubling the capacity until it does
+ *
+ * @note Only call once the GPU is done with the buffer, e.g. after the fence of the frame owning
+ * it has been waited on. The old contents are copied over and marked dirty.
+ *
+ * @param count Number of elements that will be written
+ *
+ * @return true if the buffer was reallocated and descriptor sets referencing it must be rewritten
+ */
+bool ObtGrowableBuffer::reserve(uint32_t count) {
+	if (count <= capacity) return false;
+
+	uint32_t newCapacity = capacity;
+	while (newCapacity < count) newCapacity *= 2;
+
+	auto newBuffer = createBuffer(newCapacity);
+	std::memcpy(newBuffer->getMappedMemory(), buffer->getMappedMemory(), buffer->getBufferSize());
+	newBuffer->markDirty(buffer->getBufferSize(), 0);
+
+	buffer = std::move(newBuffer);
+	capacity = newCapacity;
+	generation++;
+	return true;
+}
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "obt_device.hpp"
+#include "obt_buffer.hpp"
+
+#include <memory>
+
+namespace obt {
+
+// Host visible storage buffer that reallocates with capacity doubling, its contents are kept
+// across growth and getGeneration() changes whenever descriptor sets need to be rewritten
+class ObtGrowableBuffer {
+	public:
+		ObtGrowableBuffer(ObtDevice& obtDevice, VkDeviceSize elementSize, uint32_t initialCapacity, VkBufferUsageFlags usageFlags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+		ObtGrowableBuffer(const ObtGrowableBuffer&) = delete;
+		ObtGrowableBuffer &operator=(const ObtGrowableBuffer&) = delete;
+
+		bool reserve(uint32_t count);
+
+		template<typename T>
+		T* data() { return static_cast<T*>(buffer->getMappedMemory()); }
+
+		ObtBuffer& getBuffer() { return *buffer; }
+		uint32_t getCapacity() const { return capacity; }
+		uint32_t getGeneration() const { return generation; }
+		VkDescriptorBufferInfo descriptorInfo() { return buffer->descriptorInfo(elementSize * capacity, 0); }
+
+	private:
+		std::unique_ptr<ObtBuffer> createBuffer(uint32_t capacity);
+
+		ObtDevice& obtDevice;
+		VkDeviceSize elementSize;
+		VkBufferUsageFlags usageFlags;
+
+		std::unique_ptr<ObtBuffer> buffer;
+		uint32_t capacity;
+		uint32_t generation = 0;
+};
+
+}
@@ -3,34 +3,38 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include <algorithm>
 #include <stdexcept>
 
 namespace obt {
 
-ObtSampler::ObtSampler(ObtDevice& obtDevice, VkFilter filter, VkSamplerAddressMode addressMode, VkBool32 anisotropy) : obtDevice{obtDevice} {
+ObtSampler::ObtSampler(ObtDevice& obtDevice, const ObtSamplerInfo& info) : obtDevice{obtDevice} {
 	VkSamplerCreateInfo samplerInfo{};
 	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	samplerInfo.magFilter = filter;
-	samplerInfo.minFilter = filter;
-	samplerInfo.addressModeU = addressMode;
-	samplerInfo.addressModeV = addressMode;
-	samplerInfo.addressModeW = addressMode;
-	samplerInfo.anisotropyEnable = anisotropy;
-	samplerInfo.maxAnisotropy = anisotropy ? obtDevice.properties.limits.maxSamplerAnisotropy : 1.f;
-	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	samplerInfo.magFilter = info.magFilter;
+	samplerInfo.minFilter = info.minFilter;
+	samplerInfo.addressModeU = info.addressModeU;
+	samplerInfo.addressModeV = info.addressModeV;
+	samplerInfo.addressModeW = info.addressModeW;
+	samplerInfo.anisotropyEnable = info.anisotropyEnable;
+	samplerInfo.maxAnisotropy = info.anisotropyEnable ? std::min(info.maxAnisotropy, obtDevice.properties.limits.maxSamplerAnisotropy) : 1.f;
+	samplerInfo.borderColor = info.borderColor;
 	samplerInfo.unnormalizedCoordinates = VK_FALSE;
-	samplerInfo.compareEnable = VK_FALSE;
-	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-	samplerInfo.mipLodBias = 0.f;
-	samplerInfo.minLod = 0.f;
-	samplerInfo.maxLod = 0.f;
+	samplerInfo.compareEnable = info.compareEnable;
+	samplerInfo.compareOp = info.compareOp;
+	samplerInfo.mipmapMode = info.mipmapMode;
+	samplerInfo.mipLodBias = info.mipLodBias;
+	samplerInfo.minLod = info.minLod;
+	samplerInfo.maxLod = info.maxLod;
 
 	if (vkCreateSampler(obtDevice.device(), &samplerInfo, nullptr, &imageSampler) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create image sampler!");
 	}
 }
 
+ObtSampler::ObtSampler(ObtDevice& obtDevice, VkFilter filter, VkSamplerAddressMode addressMode, VkBool32 anisotropy)
+	: ObtSampler{obtDevice, ObtSamplerInfo{filter, filter, VK_SAMPLER_MIPMAP_MODE_LINEAR, addressMode, addressMode, addressMode, anisotropy}} {}
+
 ObtSampler::~ObtSampler() {
 	vkDestroySampler(obtDevice.device(), imageSampler, nullptr);
 }
@@ -38,18 +42,50 @@ ObtSampler::~ObtSampler() {
 ObtImage::ObtImage(ObtDevice& obtDevice, const std::string& filePath, VkFormat imageFormat) : obtDevice{obtDevice}, imageFormat{imageFormat} {
 	createImageFromFile(filePath);
 	createImageView();
+	obtDevice.registerRelocatable(this);
 }
 
 ObtImage::~ObtImage() {
+	obtDevice.unregisterRelocatable(this);
 	vkDestroyImageView(obtDevice.device(), imageView, nullptr);
-	vkDestroyImage(obtDevice.device(), textureImage, nullptr);
-	vkFreeMemory(obtDevice.device(), textureImageMemory, nullptr);
+	obtDevice.destroyImage(textureImage, textureImageMemory);
+}
+
+/**
+ * Returns the single or dual channel equivalent of an RGBA8 format, or VK_FORMAT_UNDEFINED if the
+ * texture should be expanded to four channels
+ */
+VkFormat ObtImage::nativeChannelFormat(VkFormat format, int channels) {
+	if (format == VK_FORMAT_R8G8B8A8_SRGB) {
+		if (channels == 1) return VK_FORMAT_R8_SRGB;
+		if (channels == 2) return VK_FORMAT_R8G8_SRGB;
+	} else if (format == VK_FORMAT_R8G8B8A8_UNORM) {
+		if (channels == 1) return VK_FORMAT_R8_UNORM;
+		if (channels == 2) return VK_FORMAT_R8G8_UNORM;
+	}
+	return VK_FORMAT_UNDEFINED;
 }
 
 void ObtImage::createImageFromFile(const std::string& filePath) {
 	int texWidth, texHeight, texChannels;
-	stbi_uc* pixels = stbi_load(filePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-	VkDeviceSize imageSize = texWidth*texHeight*4;
+	if (!stbi_info(filePath.c_str(), &texWidth, &texHeight, &texChannels)) throw std::runtime_error("Failed to load texture file!");
+
+	// Grayscale and grayscale+alpha textures keep their channel count, the view swizzle expands
+	// them back to rgba so shaders sample the same values as the four channel upload
+	int desiredChannels = STBI_rgb_alpha;
+	VkFormat nativeFormat = nativeChannelFormat(imageFormat, texChannels);
+	if (nativeFormat != VK_FORMAT_UNDEFINED && obtDevice.isFormatSupported(nativeFormat, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
+		imageFormat = nativeFormat;
+		desiredChannels = texChannels;
+		if (texChannels == 1) {
+			components = {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ONE};
+		} else {
+			components = {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G};
+		}
+	}
+
+	stbi_uc* pixels = stbi_load(filePath.c_str(), &texWidth, &texHeight, &texChannels, desiredChannels);
+	VkDeviceSize imageSize = static_cast<VkDeviceSize>(texWidth)*texHeight*desiredChannels;
 
 	if (!pixels) throw std::runtime_error("Failed to load texture file!");
 
@@ -60,7 +96,6 @@ void ObtImage::createImageFromFile(const std::string& filePath) {
 
 	stbi_image_free(pixels);
 
-	VkImageCreateInfo imageInfo{};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	imageInfo.imageType = VK_IMAGE_TYPE_2D;
 	imageInfo.extent.width = static_cast<uint32_t>(texWidth);
@@ -71,7 +106,7 @@ void ObtImage::createImageFromFile(const std::string& filePath) {
 	imageInfo.format = imageFormat;
 	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 	imageInfo.flags = 0;
@@ -124,6 +159,7 @@ void ObtImage::createImageView() {
 	viewInfo.image = textureImage;
 	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 	viewInfo.format = imageFormat;
+	viewInfo.components = components;
 	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	viewInfo.subresourceRange.baseMipLevel = 0;
 	viewInfo.subresourceRange.levelCount = 1;
@@ -135,6 +171,17 @@ void ObtImage::createImageView() {
 	}
 }
 
+/**
+ * Moves the image to a new allocation with a GPU copy, descriptor sets using the old view have to
+ * be rewritten once getGeneration() changes
+ */
+void ObtImage::relocate(VkCommandBuffer commandBuffer, ObtRetiredResource& retired) {
+	retired.imageView = imageView;
+	obtDevice.relocateImage(commandBuffer, imageInfo, textureImage, textureImageMemory, retired);
+	createImageView();
+	generation++;
+}
+
 VkDescriptorImageInfo ObtImage::descriptorInfo(VkSampler sampler) {
 	return VkDescriptorImageInfo{sampler, imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
 }
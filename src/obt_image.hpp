@@ -3,12 +3,39 @@
 #include "obt_device.hpp"
 #include "obt_buffer.hpp"
 
+#include <limits>
 #include <memory>
 
 namespace obt {
 
+struct ObtSamplerInfo {
+	VkFilter magFilter = VK_FILTER_LINEAR;
+	VkFilter minFilter = VK_FILTER_LINEAR;
+	VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	VkSamplerAddressMode addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	VkSamplerAddressMode addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	VkSamplerAddressMode addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	VkBool32 anisotropyEnable = VK_TRUE;
+	float maxAnisotropy = std::numeric_limits<float>::max();
+	float mipLodBias = 0.f;
+	float minLod = 0.f;
+	float maxLod = 0.f;
+	VkBorderColor borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	VkBool32 compareEnable = VK_FALSE;
+	VkCompareOp compareOp = VK_COMPARE_OP_ALWAYS;
+
+	bool operator==(const ObtSamplerInfo& other) const {
+		return magFilter == other.magFilter && minFilter == other.minFilter && mipmapMode == other.mipmapMode &&
+			addressModeU == other.addressModeU && addressModeV == other.addressModeV && addressModeW == other.addressModeW &&
+			anisotropyEnable == other.anisotropyEnable && maxAnisotropy == other.maxAnisotropy && mipLodBias == other.mipLodBias &&
+			minLod == other.minLod && maxLod == other.maxLod && borderColor == other.borderColor &&
+			compareEnable == other.compareEnable && compareOp == other.compareOp;
+	}
+};
+
 class ObtSampler {
 	public:
+		ObtSampler(ObtDevice& obtDevice, const ObtSamplerInfo& samplerInfo);
 		ObtSampler(ObtDevice& obtDevice, VkFilter filter = VK_FILTER_LINEAR, VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT, VkBool32 anisotropy = VK_TRUE);
 		~ObtSampler();
 
@@ -23,7 +50,7 @@ class ObtSampler {
 		VkSampler imageSampler;
 };
 
-class ObtImage {
+class ObtImage : public ObtRelocatable {
 	public:
 		ObtImage(ObtDevice& obtDevice, const std::string& filePath, VkFormat imageFormat = VK_FORMAT_R8G8B8A8_SRGB);
 		~ObtImage();
@@ -32,8 +59,14 @@ class ObtImage {
 		ObtImage &operator=(const ObtImage&) = delete;
 
 		VkDescriptorImageInfo descriptorInfo(VkSampler sampler);
+		uint32_t getGeneration() const { return generation; }
+
+		const ObtAllocation& getAllocation() const override { return textureImageMemory; }
+		void relocate(VkCommandBuffer commandBuffer, ObtRetiredResource& retired) override;
 
 	private:
+		static VkFormat nativeChannelFormat(VkFormat format, int channels);
+
 		void createImageFromFile(const std::string& filePath);
 		void transitionImageLayout(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
 		void createImageView();
@@ -41,9 +74,12 @@ class ObtImage {
 		ObtDevice& obtDevice;
 
 		VkImage textureImage;
-		VkDeviceMemory textureImageMemory;
+		ObtAllocation textureImageMemory;
+		VkImageCreateInfo imageInfo{};
 		VkImageView imageView;
 		VkFormat imageFormat;
+		VkComponentMapping components{VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY};
+		uint32_t generation = 0;
 };
 
 }
@@ -0,0 +1,167 @@
+#include "obt_job_system.hpp"
+
+namespace obt {
+
+// Queue owned by the calling thread, 0 for every thread that is not a worker of the system
+static thread_local const ObtJobSystem* currentSystem = nullptr;
+static thread_local uint32_t currentQueueIndex = 0;
+
+/**
+ * @return One worker less than the number of hardware threads, the thread driving the frame
+ * takes the remaining one
+ */
+uint32_t ObtJobSystem::defaultWorkerCount() {
+	uint32_t threads = std::thread::hardware_concurrency();
+	return threads > 1 ? threads - 1 : 0;
+}
+
+ObtJobSystem::ObtJobSystem(uint32_t workerCount) {
+	queues.resize(workerCount + 1);
+	for (auto& queue : queues) {
+		queue = std::make_unique<Queue>();
+	}
+
+	workers.reserve(workerCount);
+	for (uint32_t i = 0; i < workerCount; i++) {
+		workers.emplace_back(&ObtJobSystem::workerLoop, this, i + 1);
+	}
+}
+
+ObtJobSystem::~ObtJobSystem() {
+	{
+		std::lock_guard<std::mutex> lock{sleepMutex};
+		running = false;
+	}
+	wakeCondition.notify_all();
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+/**
+ * Queues a job on the calling thread's deque
+ *
+ * @param job Function to run
+ * @param counter Incremented now and decremented once the job has run, may be null
+ * @param dependency The job is held back until this counter reaches zero, may be null
+ */
+void ObtJobSystem::schedule(std::function<void()> job, ObtJobCounter* counter, ObtJobCounter* dependency) {
+	if (counter != nullptr) {
+		counter->count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	if (dependency != nullptr) {
+		std::lock_guard<std::mutex> lock{dependency->mutex};
+		if (!dependency->isDone()) {
+			dependency->continuations.emplace_back(std::move(job), counter);
+			return;
+		}
+	}
+
+	push(Job{std::move(job), counter});
+}
+
+/**
+ * Blocks until the counter reaches zero, running queued jobs in the meantime so waiting from
+ * inside a job cannot deadlock the workers
+ */
+void ObtJobSystem::wait(ObtJobCounter& counter) {
+	while (!counter.isDone()) {
+		if (!runOne()) {
+			std::this_thread::yield();
+		}
+	}
+
+	// The last finishing job may still hold the lock, it must be released before the counter can
+	// go out of scope
+	std::lock_guard<std::mutex> lock{counter.mutex};
+}
+
+void ObtJobSystem::push(Job job) {
+	{
+		// Counted before it becomes visible so a thief can never decrement below zero, and under
+		// the lock so a worker checking the count before sleeping cannot miss it
+		std::lock_guard<std::mutex> lock{sleepMutex};
+		queuedJobs.fetch_add(1, std::memory_order_release);
+	}
+
+	Queue& queue = *queues[currentQueue()];
+	{
+		std::lock_guard<std::mutex> lock{queue.mutex};
+		queue.jobs.push_back(std::move(job));
+	}
+	wakeCondition.notify_one();
+}
+
+/**
+ * Takes the newest job of the own deque, or steals the oldest job of another one
+ */
+bool ObtJobSystem::pop(Job& job) {
+	uint32_t own = currentQueue();
+	{
+		Queue& queue = *queues[own];
+		std::lock_guard<std::mutex> lock{queue.mutex};
+		if (!queue.jobs.empty()) {
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+			return true;
+		}
+	}
+
+	for (uint32_t i = 1; i < queues.size(); i++) {
+		Queue& queue = *queues[(own + i) % queues.size()];
+		std::lock_guard<std::mutex> lock{queue.mutex};
+		if (!queue.jobs.empty()) {
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ObtJobSystem::runOne() {
+	if (queuedJobs.load(std::memory_order_acquire) == 0) return false;
+
+	Job job;
+	if (!pop(job)) return false;
+	queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+
+	job.function();
+	finish(job.counter);
+	return true;
+}
+
+void ObtJobSystem::finish(ObtJobCounter* counter) {
+	if (counter == nullptr) return;
+
+	std::vector<std::pair<std::function<void()>, ObtJobCounter*>> continuations;
+	{
+		std::lock_guard<std::mutex> lock{counter->mutex};
+		if (counter->count.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+		continuations.swap(counter->continuations);
+	}
+	for (auto& continuation : continuations) {
+		push(Job{std::move(continuation.first), continuation.second});
+	}
+}
+
+void ObtJobSystem::workerLoop(uint32_t queueIndex) {
+	currentSystem = this;
+	currentQueueIndex = queueIndex;
+
+	while (true) {
+		if (runOne()) continue;
+
+		std::unique_lock<std::mutex> lock{sleepMutex};
+		wakeCondition.wait(lock, [this]() { return !running || queuedJobs.load(std::memory_order_acquire) > 0; });
+		if (!running) return;
+	}
+}
+
+uint32_t ObtJobSystem::currentQueue() const {
+	return currentSystem == this ? currentQueueIndex : 0;
+}
+
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace obt {
+
+class ObtJobSystem;
+
+// Counts outstanding jobs, jobs scheduled with it as their dependency start once it reaches zero.
+// A counter that had jobs scheduled on it must be waited on before it is destroyed.
+class ObtJobCounter {
+	public:
+		ObtJobCounter() = default;
+
+		ObtJobCounter(const ObtJobCounter&) = delete;
+		ObtJobCounter &operator=(const ObtJobCounter&) = delete;
+
+		bool isDone() const { return count.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class ObtJobSystem;
+
+		std::atomic<uint32_t> count{0};
+		std::mutex mutex;
+		std::vector<std::pair<std::function<void()>, ObtJobCounter*>> continuations;
+};
+
+// Work stealing scheduler, every worker owns a deque it pushes to and pops from at the back while
+// idle workers steal from the front of the others. Threads that are not workers share one extra
+// deque and help run jobs while they wait on a counter.
+//
+// Jobs must not throw, record failures and report them after waiting instead.
+class ObtJobSystem {
+	public:
+		ObtJobSystem(uint32_t workerCount = defaultWorkerCount());
+		~ObtJobSystem();
+
+		ObtJobSystem(const ObtJobSystem&) = delete;
+		ObtJobSystem &operator=(const ObtJobSystem&) = delete;
+
+		void schedule(std::function<void()> job, ObtJobCounter* counter = nullptr, ObtJobCounter* dependency = nullptr);
+		void wait(ObtJobCounter& counter);
+
+		// Splits [0, count) into chunks of at most grainSize and calls function(begin, end) for each
+		// of them in parallel, returns once all chunks are done
+		template<typename F>
+		void parallelFor(uint32_t count, uint32_t grainSize, F&& function) {
+			grainSize = std::max(grainSize, 1u);
+			if (count <= grainSize || workers.empty()) {
+				if (count > 0) function(0u, count);
+				return;
+			}
+
+			ObtJobCounter counter;
+			for (uint32_t begin = grainSize; begin < count; begin += grainSize) {
+				uint32_t end = std::min(begin + grainSize, count);
+				schedule([&function, begin, end]() { function(begin, end); }, &counter);
+			}
+			// The caller takes the first chunk itself instead of idling
+			function(0u, grainSize);
+			wait(counter);
+		}
+
+		uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()) + 1; }
+		// Below getThreadCount(), workers are numbered from 1 and every other thread is 0, so only
+		// one thread that is not a worker should use it to pick per thread resources
+		uint32_t getThreadIndex() const { return currentQueue(); }
+
+		static uint32_t defaultWorkerCount();
+
+	private:
+		struct Job {
+			std::function<void()> function;
+			ObtJobCounter* counter;
+		};
+
+		struct Queue {
+			std::mutex mutex;
+			std::deque<Job> jobs;
+		};
+
+		void push(Job job);
+		bool runOne();
+		bool pop(Job& job);
+		void finish(ObtJobCounter* counter);
+		void workerLoop(uint32_t queueIndex);
+		uint32_t currentQueue() const;
+
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> workers;
+
+		std::mutex sleepMutex;
+		std::condition_variable wakeCondition;
+		std::atomic<uint32_t> queuedJobs{0};
+		bool running = true;
+};
+
+}
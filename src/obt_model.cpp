@@ -1,6 +1,7 @@
 #include "obt_model.hpp"
 
 #include "obt_utils.hpp"
+#include "obt_job_system.hpp"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
@@ -8,7 +9,9 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/hash.hpp>
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstring>
 #include <unordered_map>
 
@@ -27,24 +30,52 @@ struct hash<obt::ObtModel::Vertex> {
 
 namespace obt {
 
-ObtModel::ObtModel(ObtDevice& obtDevice, const ObtModel::Builder& builder) : obtDevice{obtDevice} {
+ObtModel::ObtModel(ObtDevice& obtDevice, const ObtModel::Builder& builder, ObtGeometryPool* geometryPool) : obtDevice{obtDevice}, geometryPool{geometryPool} {
 	createVertexBuffers(builder.vertices);
 	createIndexBuffers(builder.indices);
+	computeBoundingSphere(builder.vertices);
 }
 
 ObtModel::~ObtModel() {}
 
-std::unique_ptr<ObtModel> ObtModel::createModelFromFile(ObtDevice& device, const std::string& filePath) {
+std::unique_ptr<ObtModel> ObtModel::createModelFromFile(ObtDevice& device, const std::string& filePath, ObtJobSystem* jobSystem, ObtGeometryPool* geometryPool) {
 	Builder builder{};
-	builder.loadModel(filePath);
+	builder.loadModel(filePath, jobSystem);
 
-	return std::make_unique<ObtModel>(device, builder);
+	return std::make_unique<ObtModel>(device, builder, geometryPool);
+}
+
+/**
+ * Fits a sphere around the center of the vertices' bounding box, not the tightest sphere but
+ * cheap and stable for culling
+ */
+void ObtModel::computeBoundingSphere(const std::vector<Vertex>& vertices) {
+	glm::vec3 min{vertices[0].position};
+	glm::vec3 max{vertices[0].position};
+	for (const auto& vertex : vertices) {
+		min = glm::min(min, vertex.position);
+		max = glm::max(max, vertex.position);
+	}
+
+	glm::vec3 center = (min + max) * .5f;
+	float radiusSquared = 0.f;
+	for (const auto& vertex : vertices) {
+		glm::vec3 offset = vertex.position - center;
+		radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+	}
+	boundingSphere = glm::vec4{center, std::sqrt(radiusSquared)};
 }
 
 void ObtModel::createVertexBuffers(const std::vector<Vertex>& vertices) {
 	vertexCount = static_cast<uint32_t>(vertices.size());
 	assert(vertexCount >= 3 && "Vertex count must be at least 3!");
 
+	if (geometryPool != nullptr) {
+		assert(geometryPool->getVertexSize() == sizeof(vertices[0]) && "Geometry pool vertex size does not match!");
+		firstVertex = geometryPool->addVertices(vertices.data(), vertexCount);
+		return;
+	}
+
 	VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
 	uint32_t vertexSize = sizeof(vertices[0]);
 	ObtBuffer stagingBuffer{obtDevice, vertexSize, vertexCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
@@ -60,6 +91,11 @@ void ObtModel::createIndexBuffers(const std::vector<uint32_t>& indices) {
 	hasIndexBuffer = indexCount > 0;
 	if (!hasIndexBuffer) return;
 
+	if (geometryPool != nullptr) {
+		firstIndex = geometryPool->addIndices(indices.data(), indexCount);
+		return;
+	}
+
 	VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
 	uint32_t indexSize = sizeof(indices[0]);
 	ObtBuffer stagingBuffer{obtDevice, indexSize, indexCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
@@ -70,15 +106,23 @@ void ObtModel::createIndexBuffers(const std::vector<uint32_t>& indices) {
 	obtDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
 }
 
-void ObtModel::draw(VkCommandBuffer commandBuffer, uint32_t instance) {
+void ObtModel::draw(VkCommandBuffer commandBuffer, uint32_t firstInstance, uint32_t instanceCount) {
 	if (hasIndexBuffer) {
-		vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, instance);
+		vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, 0, 0, firstInstance);
 	} else {
-		vkCmdDraw(commandBuffer, vertexCount, 1, 0, instance);
+		vkCmdDraw(commandBuffer, vertexCount, instanceCount, 0, firstInstance);
 	}
 }
 
 void ObtModel::bind(VkCommandBuffer commandBuffer) {
+	if (geometryPool != nullptr) {
+		VkBuffer buffers[] = {geometryPool->getVertexBuffer()};
+		VkDeviceSize offsets[] = {geometryPool->getVertexSize() * firstVertex};
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+		if (hasIndexBuffer) vkCmdBindIndexBuffer(commandBuffer, geometryPool->getIndexBuffer(), sizeof(uint32_t) * firstIndex, VK_INDEX_TYPE_UINT32);
+		return;
+	}
+
 	VkBuffer buffers[] = {vertexBuffer->getBuffer()};
 	VkDeviceSize offsets[] = {0};
 	vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
@@ -105,7 +149,52 @@ std::vector<VkVertexInputAttributeDescription> ObtModel::Vertex::getAttributeDes
 	return attributeDescriptions;
 }
 
-void ObtModel::Builder::loadModel(const std::string& filePath) {
+static ObtModel::Vertex readVertex(const tinyobj::attrib_t& attrib, const tinyobj::index_t& index) {
+	ObtModel::Vertex vertex{};
+
+	if (index.vertex_index >= 0) {
+		vertex.position = {
+			attrib.vertices[3*index.vertex_index+0],
+			attrib.vertices[3*index.vertex_index+1],
+			attrib.vertices[3*index.vertex_index+2]
+		};
+
+		vertex.color = {
+			attrib.colors[3*index.vertex_index+0],
+			attrib.colors[3*index.vertex_index+1],
+			attrib.colors[3*index.vertex_index+2]
+		};
+	}
+
+	if (index.normal_index >= 0) {
+		vertex.normal = {
+			attrib.normals[3*index.normal_index+0],
+			attrib.normals[3*index.normal_index+1],
+			attrib.normals[3*index.normal_index+2]
+		};
+	}
+
+	if (index.texcoord_index >= 0) {
+		vertex.uv = {
+			attrib.texcoords[2*index.texcoord_index+0],
+			1.f - attrib.texcoords[2*index.texcoord_index+1],
+		};
+	}
+
+	return vertex;
+}
+
+/**
+ * Loads an OBJ file and deduplicates its vertices
+ *
+ * @note Parsing itself is done by tinyobjloader on the calling thread. With a job system the
+ * faces are split into chunks that build and deduplicate their vertices in parallel, the chunks
+ * are then merged in order so the result is identical to a serial load.
+ *
+ * @param filePath Path of the OBJ file
+ * @param jobSystem Optional job system to spread vertex processing over
+ */
+void ObtModel::Builder::loadModel(const std::string& filePath, ObtJobSystem* jobSystem) {
 	tinyobj::attrib_t attrib;
 	std::vector<tinyobj::shape_t> shapes;
 	std::vector<tinyobj::material_t> materials;
@@ -118,47 +207,88 @@ void ObtModel::Builder::loadModel(const std::string& filePath) {
 	vertices.clear();
 	indices.clear();
 
-	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+	std::vector<tinyobj::index_t> objIndices;
 	for (const auto& shape : shapes) {
-		for (const auto& index : shape.mesh.indices) {
-			Vertex vertex{};
-
-			if (index.vertex_index >= 0) {
-				vertex.position = {
-					attrib.vertices[3*index.vertex_index+0],
-					attrib.vertices[3*index.vertex_index+1],
-					attrib.vertices[3*index.vertex_index+2]
-				};
-
-				vertex.color = {
-					attrib.colors[3*index.vertex_index+0],
-					attrib.colors[3*index.vertex_index+1],
-					attrib.colors[3*index.vertex_index+2]
-				};
-			}
+		objIndices.insert(objIndices.end(), shape.mesh.indices.begin(), shape.mesh.indices.end());
+	}
 
-			if (index.normal_index >= 0) {
-				vertex.normal = {
-					attrib.normals[3*index.normal_index+0],
-					attrib.normals[3*index.normal_index+1],
-					attrib.normals[3*index.normal_index+2]
-				};
+	struct Chunk {
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<uint32_t> remap;
+	};
+
+	uint32_t indexCount = static_cast<uint32_t>(objIndices.size());
+	uint32_t chunkCount = (indexCount + LOAD_CHUNK_SIZE - 1) / LOAD_CHUNK_SIZE;
+	std::vector<Chunk> chunks(chunkCount);
+
+	auto forEachChunk = [&](auto&& function) {
+		auto range = [&](uint32_t begin, uint32_t end) {
+			for (uint32_t chunk = begin; chunk < end; chunk++) function(chunk, chunk * LOAD_CHUNK_SIZE, std::min((chunk + 1) * LOAD_CHUNK_SIZE, indexCount));
+		};
+		if (jobSystem != nullptr) {
+			jobSystem->parallelFor(chunkCount, 1, range);
+		} else {
+			range(0, chunkCount);
+		}
+	};
+
+	forEachChunk([&](uint32_t chunk, uint32_t begin, uint32_t end) {
+		Chunk& local = chunks[chunk];
+		std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+		local.indices.reserve(end - begin);
+		for (uint32_t i = begin; i < end; i++) {
+			Vertex vertex = readVertex(attrib, objIndices[i]);
+			auto result = uniqueVertices.emplace(vertex, static_cast<uint32_t>(local.vertices.size()));
+			if (result.second) {
+				local.vertices.push_back(vertex);
 			}
+			local.indices.push_back(result.first->second);
+		}
+	});
 
-			if (index.texcoord_index >= 0) {
-				vertex.uv = {
-					attrib.texcoords[2*index.texcoord_index+0],
-					1.f - attrib.texcoords[2*index.texcoord_index+1],
-				};
+	// Merging in chunk order keeps vertices in order of first appearance, as a serial load would
+	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+	for (Chunk& chunk : chunks) {
+		chunk.remap.resize(chunk.vertices.size());
+		for (size_t i = 0; i < chunk.vertices.size(); i++) {
+			auto result = uniqueVertices.emplace(chunk.vertices[i], static_cast<uint32_t>(vertices.size()));
+			if (result.second) {
+				vertices.push_back(chunk.vertices[i]);
 			}
+			chunk.remap[i] = result.first->second;
+		}
+	}
 
-			if (uniqueVertices.count(vertex) == 0) {
-				uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-				vertices.push_back(vertex);
-			}
-			indices.push_back(uniqueVertices[vertex]);
+	indices.resize(indexCount);
+	forEachChunk([&](uint32_t chunk, uint32_t begin, uint32_t end) {
+		const Chunk& local = chunks[chunk];
+		for (uint32_t i = begin; i < end; i++) {
+			indices[i] = local.remap[local.indices[i - begin]];
+		}
+	});
+}
+
+/**
+ * Copies the positions and triangles of the loaded mesh for use as an occluder, for models simple
+ * enough to occlude with their full geometry
+ */
+ObtModel::OccluderMesh ObtModel::Builder::createOccluderMesh() const {
+	OccluderMesh mesh{};
+	mesh.positions.reserve(vertices.size());
+	for (const auto& vertex : vertices) {
+		mesh.positions.push_back(vertex.position);
+	}
+
+	if (indices.empty()) {
+		mesh.indices.resize(vertices.size());
+		for (uint32_t i = 0; i < vertices.size(); i++) {
+			mesh.indices[i] = i;
 		}
+	} else {
+		mesh.indices = indices;
 	}
+	return mesh;
 }
 
 }
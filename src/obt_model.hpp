@@ -2,6 +2,7 @@
 
 #include "obt_device.hpp"
 #include "obt_buffer.hpp"
+#include "obt_geometry_pool.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -12,6 +13,8 @@
 
 namespace obt {
 
+class ObtJobSystem;
+
 class ObtModel {
 	public:
 		struct Vertex {
@@ -28,29 +31,57 @@ class ObtModel {
 			}
 		};
 
+		// CPU side triangle list for occlusion culling, usually a simplified version of the model
+		struct OccluderMesh {
+			std::vector<glm::vec3> positions{};
+			std::vector<uint32_t> indices{};
+		};
+
 		struct Builder {
+			static constexpr uint32_t LOAD_CHUNK_SIZE = 64 * 1024;
+
 			std::vector<Vertex> vertices{};
 			std::vector<uint32_t> indices{};
 
-			void loadModel(const std::string& filePath);
+			void loadModel(const std::string& filePath, ObtJobSystem* jobSystem = nullptr);
+			OccluderMesh createOccluderMesh() const;
 		};
 
-		ObtModel(ObtDevice& obtDevice, const ObtModel::Builder& builder);
+		ObtModel(ObtDevice& obtDevice, const ObtModel::Builder& builder, ObtGeometryPool* geometryPool = nullptr);
 		~ObtModel();
 
 		ObtModel(const ObtModel&) = delete;
 		ObtModel &operator=(const ObtModel&) = delete;
 
-		static std::unique_ptr<ObtModel> createModelFromFile(ObtDevice& device, const std::string& filePath);
+		static std::unique_ptr<ObtModel> createModelFromFile(ObtDevice& device, const std::string& filePath, ObtJobSystem* jobSystem = nullptr, ObtGeometryPool* geometryPool = nullptr);
 
 		void bind(VkCommandBuffer commandBuffer);
-		void draw(VkCommandBuffer commandBuffer, uint32_t instance = 0);
+		void draw(VkCommandBuffer commandBuffer, uint32_t firstInstance = 0, uint32_t instanceCount = 1);
+
+		// Zero for models drawn without an index buffer
+		uint32_t getIndexCount() const { return hasIndexBuffer ? indexCount : 0; }
+
+		// Models in a geometry pool own a vertex and index range of the pool's buffers, bind() binds
+		// the ranges so draws stay relative to them
+		ObtGeometryPool* getGeometryPool() const { return geometryPool; }
+		uint32_t getFirstVertex() const { return firstVertex; }
+		uint32_t getFirstIndex() const { return firstIndex; }
+
+		// Local space bounding sphere, center in xyz and radius in w
+		const glm::vec4& getBoundingSphere() const { return boundingSphere; }
+
+		void setOccluderMesh(OccluderMesh mesh) { occluderMesh = std::move(mesh); }
+		const OccluderMesh& getOccluderMesh() const { return occluderMesh; }
 
 	private:
 		void createVertexBuffers(const std::vector<Vertex>& vertices);
 		void createIndexBuffers(const std::vector<uint32_t>& indices);
+		void computeBoundingSphere(const std::vector<Vertex>& vertices);
 
 		ObtDevice& obtDevice;
+		ObtGeometryPool* geometryPool;
+		uint32_t firstVertex = 0;
+		uint32_t firstIndex = 0;
 
 		std::unique_ptr<ObtBuffer> vertexBuffer;
 		uint32_t vertexCount;
@@ -58,6 +89,9 @@ class ObtModel {
 		bool hasIndexBuffer = false;
 		std::unique_ptr<ObtBuffer> indexBuffer;
 		uint32_t indexCount;
+
+		glm::vec4 boundingSphere{0.f};
+		OccluderMesh occluderMesh{};
 };
 
 }
@@ -0,0 +1,320 @@
+#include "obt_occlusion_culling.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define OBT_OCCLUSION_CULLING_X86
+#include <immintrin.h>
+#endif
+
+namespace obt {
+
+static constexpr uint32_t FULL_COVERAGE = ~0u;
+
+// Screen space triangle ready for rasterization, edge i is inside where a * x + b * y + c >= 0 and
+// depth is a plane over the screen clamped to the farthest vertex
+struct TriangleSetup {
+	float edgeA[3];
+	float edgeB[3];
+	float edgeC[3];
+	float depthX;
+	float depthY;
+	float depthC;
+	float depthMax;
+	uint32_t tileMinX;
+	uint32_t tileMinY;
+	uint32_t tileMaxX;
+	uint32_t tileMaxY;
+};
+
+struct TileBuffer {
+	uint32_t tilesPerRow;
+	float* referenceDepths;
+	float* workingDepths;
+	uint32_t* coverageMasks;
+};
+
+// Farthest depth of the triangle over a tile, taken at the tile corner the depth plane rises to
+static float tileDepth(const TriangleSetup& tri, float x, float y) {
+	float farX = tri.depthX > 0.f ? x + ObtOcclusionCuller::TILE_WIDTH : x;
+	float farY = tri.depthY > 0.f ? y + ObtOcclusionCuller::TILE_HEIGHT : y;
+	return std::min(tri.depthMax, tri.depthX * farX + tri.depthY * farY + tri.depthC);
+}
+
+/**
+ * Merges a triangle's coverage into a tile. A triangle whose depth is closer to the reference than
+ * to the working layer starts a new working layer, dropping the old one only loses occlusion and
+ * keeps the tile conservative.
+ */
+static void updateTile(const TileBuffer& buffer, uint32_t tile, uint32_t coverage, float depth) {
+	float& reference = buffer.referenceDepths[tile];
+	float& working = buffer.workingDepths[tile];
+	uint32_t& mask = buffer.coverageMasks[tile];
+	if (coverage == 0 || depth >= reference) return;
+
+	if (mask != 0 && std::abs(depth - working) > reference - depth) {
+		mask = 0;
+	}
+	working = mask == 0 ? depth : std::max(working, depth);
+	mask |= coverage;
+
+	if (mask == FULL_COVERAGE) {
+		reference = working;
+		mask = 0;
+	}
+}
+
+#ifdef OBT_OCCLUSION_CULLING_X86
+
+__attribute__((target("sse2")))
+static void rasterizeSse2(const TriangleSetup& tri, const TileBuffer& buffer) {
+	// Each tile row is two registers of four pixels, the edge values of a row differ from the
+	// tile's first pixel by a fixed per lane offset
+	__m128 edgeA[3], edgeB[3], laneLow[3], laneHigh[3];
+	for (int e = 0; e < 3; e++) {
+		edgeA[e] = _mm_set1_ps(tri.edgeA[e]);
+		edgeB[e] = _mm_set1_ps(tri.edgeB[e]);
+		laneLow[e] = _mm_mul_ps(edgeA[e], _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+		laneHigh[e] = _mm_mul_ps(edgeA[e], _mm_setr_ps(4.5f, 5.5f, 6.5f, 7.5f));
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	for (uint32_t ty = tri.tileMinY; ty <= tri.tileMaxY; ty++) {
+		for (uint32_t tx = tri.tileMinX; tx <= tri.tileMaxX; tx++) {
+			float x = static_cast<float>(tx * ObtOcclusionCuller::TILE_WIDTH);
+			float y = static_cast<float>(ty * ObtOcclusionCuller::TILE_HEIGHT);
+
+			__m128 rowLow[3], rowHigh[3];
+			for (int e = 0; e < 3; e++) {
+				__m128 origin = _mm_set1_ps(tri.edgeA[e] * x + tri.edgeB[e] * (y + 0.5f) + tri.edgeC[e]);
+				rowLow[e] = _mm_add_ps(origin, laneLow[e]);
+				rowHigh[e] = _mm_add_ps(origin, laneHigh[e]);
+			}
+
+			uint32_t coverage = 0;
+			for (uint32_t row = 0; row < ObtOcclusionCuller::TILE_HEIGHT; row++) {
+				__m128 insideLow = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(rowLow[0], zero), _mm_cmpge_ps(rowLow[1], zero)), _mm_cmpge_ps(rowLow[2], zero));
+				__m128 insideHigh = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(rowHigh[0], zero), _mm_cmpge_ps(rowHigh[1], zero)), _mm_cmpge_ps(rowHigh[2], zero));
+				uint32_t bits = static_cast<uint32_t>(_mm_movemask_ps(insideLow) | (_mm_movemask_ps(insideHigh) << 4));
+				coverage |= bits << (row * ObtOcclusionCuller::TILE_WIDTH);
+
+				for (int e = 0; e < 3; e++) {
+					rowLow[e] = _mm_add_ps(rowLow[e], edgeB[e]);
+					rowHigh[e] = _mm_add_ps(rowHigh[e], edgeB[e]);
+				}
+			}
+
+			updateTile(buffer, ty * buffer.tilesPerRow + tx, coverage, tileDepth(tri, x, y));
+		}
+	}
+}
+
+__attribute__((target("avx")))
+static void rasterizeAvx(const TriangleSetup& tri, const TileBuffer& buffer) {
+	// One register holds a full tile row
+	__m256 edgeB[3], lanes[3];
+	for (int e = 0; e < 3; e++) {
+		edgeB[e] = _mm256_set1_ps(tri.edgeB[e]);
+		lanes[e] = _mm256_mul_ps(_mm256_set1_ps(tri.edgeA[e]), _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+	}
+	const __m256 zero = _mm256_setzero_ps();
+
+	for (uint32_t ty = tri.tileMinY; ty <= tri.tileMaxY; ty++) {
+		for (uint32_t tx = tri.tileMinX; tx <= tri.tileMaxX; tx++) {
+			float x = static_cast<float>(tx * ObtOcclusionCuller::TILE_WIDTH);
+			float y = static_cast<float>(ty * ObtOcclusionCuller::TILE_HEIGHT);
+
+			__m256 row[3];
+			for (int e = 0; e < 3; e++) {
+				row[e] = _mm256_add_ps(_mm256_set1_ps(tri.edgeA[e] * x + tri.edgeB[e] * (y + 0.5f) + tri.edgeC[e]), lanes[e]);
+			}
+
+			uint32_t coverage = 0;
+			for (uint32_t r = 0; r < ObtOcclusionCuller::TILE_HEIGHT; r++) {
+				__m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(row[0], zero, _CMP_GE_OQ), _mm256_cmp_ps(row[1], zero, _CMP_GE_OQ)), _mm256_cmp_ps(row[2], zero, _CMP_GE_OQ));
+				coverage |= static_cast<uint32_t>(_mm256_movemask_ps(inside)) << (r * ObtOcclusionCuller::TILE_WIDTH);
+
+				for (int e = 0; e < 3; e++) {
+					row[e] = _mm256_add_ps(row[e], edgeB[e]);
+				}
+			}
+
+			updateTile(buffer, ty * buffer.tilesPerRow + tx, coverage, tileDepth(tri, x, y));
+		}
+	}
+}
+
+#else
+
+static uint32_t scalarCoverage(const TriangleSetup& tri, float x, float y) {
+	uint32_t coverage = 0;
+	for (uint32_t row = 0; row < ObtOcclusionCuller::TILE_HEIGHT; row++) {
+		for (uint32_t column = 0; column < ObtOcclusionCuller::TILE_WIDTH; column++) {
+			float px = x + column + 0.5f;
+			float py = y + row + 0.5f;
+			bool inside = true;
+			for (int e = 0; e < 3; e++) {
+				inside = inside && tri.edgeA[e] * px + tri.edgeB[e] * py + tri.edgeC[e] >= 0.f;
+			}
+			if (inside) coverage |= 1u << (row * ObtOcclusionCuller::TILE_WIDTH + column);
+		}
+	}
+	return coverage;
+}
+
+static void rasterizeScalar(const TriangleSetup& tri, const TileBuffer& buffer) {
+	for (uint32_t ty = tri.tileMinY; ty <= tri.tileMaxY; ty++) {
+		for (uint32_t tx = tri.tileMinX; tx <= tri.tileMaxX; tx++) {
+			float x = static_cast<float>(tx * ObtOcclusionCuller::TILE_WIDTH);
+			float y = static_cast<float>(ty * ObtOcclusionCuller::TILE_HEIGHT);
+			updateTile(buffer, ty * buffer.tilesPerRow + tx, scalarCoverage(tri, x, y), tileDepth(tri, x, y));
+		}
+	}
+}
+
+#endif
+
+using RasterizeFn = void (*)(const TriangleSetup&, const TileBuffer&);
+
+static RasterizeFn selectRasterize() {
+#ifdef OBT_OCCLUSION_CULLING_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx")) return rasterizeAvx;
+	return rasterizeSse2;
+#else
+	return rasterizeScalar;
+#endif
+}
+
+/**
+ * @param width Buffer width in pixels, a multiple of TILE_WIDTH
+ * @param height Buffer height in pixels, a multiple of TILE_HEIGHT
+ */
+ObtOcclusionCuller::ObtOcclusionCuller(uint32_t width, uint32_t height) : width{width}, height{height} {
+	assert(width > 0 && width % TILE_WIDTH == 0 && "Occlusion buffer width must be a multiple of the tile width");
+	assert(height > 0 && height % TILE_HEIGHT == 0 && "Occlusion buffer height must be a multiple of the tile height");
+
+	tilesPerRow = width / TILE_WIDTH;
+	tileRows = height / TILE_HEIGHT;
+	referenceDepths.resize(tilesPerRow * tileRows);
+	workingDepths.resize(tilesPerRow * tileRows);
+	coverageMasks.resize(tilesPerRow * tileRows);
+	clear();
+}
+
+void ObtOcclusionCuller::clear() {
+	std::fill(referenceDepths.begin(), referenceDepths.end(), 1.f);
+	std::fill(workingDepths.begin(), workingDepths.end(), 1.f);
+	std::fill(coverageMasks.begin(), coverageMasks.end(), 0u);
+}
+
+/**
+ * Rasterizes an indexed triangle list into the buffer, both windings count as occluding
+ *
+ * @param clipFromModel Transform from the mesh positions to clip space
+ *
+ * @note Triangles reaching in front of the near plane are skipped rather than clipped, occluders
+ * that close to the camera only lose their occlusion
+ */
+void ObtOcclusionCuller::renderOccluder(const glm::mat4& clipFromModel, const glm::vec3* positions, const uint32_t* indices, uint32_t indexCount) {
+	static const RasterizeFn rasterize = selectRasterize();
+	TileBuffer buffer{tilesPerRow, referenceDepths.data(), workingDepths.data(), coverageMasks.data()};
+
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+		float sx[3], sy[3], sz[3];
+		bool clipped = false;
+		for (int v = 0; v < 3; v++) {
+			glm::vec4 clip = clipFromModel * glm::vec4{positions[indices[i + v]], 1.f};
+			if (clip.z < 0.f || clip.w <= 0.f) {
+				clipped = true;
+				break;
+			}
+			sx[v] = (clip.x / clip.w * 0.5f + 0.5f) * width;
+			sy[v] = (clip.y / clip.w * 0.5f + 0.5f) * height;
+			sz[v] = clip.z / clip.w;
+		}
+		if (clipped) continue;
+
+		float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+		if (std::abs(area) < 1e-6f) continue;
+		if (area < 0.f) {
+			std::swap(sx[1], sx[2]);
+			std::swap(sy[1], sy[2]);
+			std::swap(sz[1], sz[2]);
+			area = -area;
+		}
+
+		float minX = std::max(std::min({sx[0], sx[1], sx[2]}), 0.f);
+		float maxX = std::min(std::max({sx[0], sx[1], sx[2]}), static_cast<float>(width) - 1.f);
+		float minY = std::max(std::min({sy[0], sy[1], sy[2]}), 0.f);
+		float maxY = std::min(std::max({sy[0], sy[1], sy[2]}), static_cast<float>(height) - 1.f);
+		if (minX > maxX || minY > maxY) continue;
+
+		TriangleSetup tri;
+		for (int e = 0; e < 3; e++) {
+			int a = e;
+			int b = (e + 1) % 3;
+			tri.edgeA[e] = sy[a] - sy[b];
+			tri.edgeB[e] = sx[b] - sx[a];
+			tri.edgeC[e] = sx[a] * sy[b] - sy[a] * sx[b];
+		}
+		tri.depthX = ((sz[1] - sz[0]) * (sy[2] - sy[0]) - (sz[2] - sz[0]) * (sy[1] - sy[0])) / area;
+		tri.depthY = ((sz[2] - sz[0]) * (sx[1] - sx[0]) - (sz[1] - sz[0]) * (sx[2] - sx[0])) / area;
+		tri.depthC = sz[0] - tri.depthX * sx[0] - tri.depthY * sy[0];
+		tri.depthMax = std::max({sz[0], sz[1], sz[2]});
+		tri.tileMinX = static_cast<uint32_t>(minX) / TILE_WIDTH;
+		tri.tileMaxX = static_cast<uint32_t>(maxX) / TILE_WIDTH;
+		tri.tileMinY = static_cast<uint32_t>(minY) / TILE_HEIGHT;
+		tri.tileMaxY = static_cast<uint32_t>(maxY) / TILE_HEIGHT;
+
+		rasterize(tri, buffer);
+	}
+}
+
+/**
+ * Tests a world space box against the occluders rendered so far
+ *
+ * @return False only when every tile the box covers on screen has occluders in front of the box's
+ * nearest point, boxes reaching in front of the near plane are always visible
+ */
+bool ObtOcclusionCuller::isVisible(const glm::mat4& clipFromWorld, const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+	float minX = std::numeric_limits<float>::max();
+	float maxX = std::numeric_limits<float>::lowest();
+	float minY = std::numeric_limits<float>::max();
+	float maxY = std::numeric_limits<float>::lowest();
+	float nearest = 1.f;
+	for (int corner = 0; corner < 8; corner++) {
+		glm::vec3 point{corner & 1 ? boxMax.x : boxMin.x, corner & 2 ? boxMax.y : boxMin.y, corner & 4 ? boxMax.z : boxMin.z};
+		glm::vec4 clip = clipFromWorld * glm::vec4{point, 1.f};
+		if (clip.z < 0.f || clip.w <= 0.f) return true;
+
+		float x = (clip.x / clip.w * 0.5f + 0.5f) * width;
+		float y = (clip.y / clip.w * 0.5f + 0.5f) * height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, clip.z / clip.w);
+	}
+
+	// Only boxes entirely off screen are rejected, one reaching into the last column or row still
+	// covers the pixels there
+	if (maxX < 0.f || minX >= static_cast<float>(width) || maxY < 0.f || minY >= static_cast<float>(height)) return false;
+
+	uint32_t tileMinX = static_cast<uint32_t>(std::max(minX, 0.f)) / TILE_WIDTH;
+	uint32_t tileMaxX = static_cast<uint32_t>(std::min(maxX, static_cast<float>(width) - 1.f)) / TILE_WIDTH;
+	uint32_t tileMinY = static_cast<uint32_t>(std::max(minY, 0.f)) / TILE_HEIGHT;
+	uint32_t tileMaxY = static_cast<uint32_t>(std::min(maxY, static_cast<float>(height) - 1.f)) / TILE_HEIGHT;
+	for (uint32_t ty = tileMinY; ty <= tileMaxY; ty++) {
+		for (uint32_t tx = tileMinX; tx <= tileMaxX; tx++) {
+			if (nearest <= referenceDepths[ty * tilesPerRow + tx]) return true;
+		}
+	}
+	return false;
+}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace obt {
+
+// CPU occlusion culling against a low resolution depth buffer in the style of masked occlusion
+// culling. The buffer is split into 8x4 pixel tiles that hold no per pixel depth, only a reference
+// depth no pixel of the tile is behind and a working layer: a coverage mask with the farthest depth
+// of the pixels it covers. Occluder triangles are rasterized a tile at a time with SIMD edge tests
+// and merged into the working layer, which replaces the reference once it covers the whole tile.
+//
+// Depth is the post projection depth from 0 at the near to 1 at the far plane. All answers are
+// conservative, an occludee is only reported hidden when occluders cover it completely.
+class ObtOcclusionCuller {
+	public:
+		static constexpr uint32_t TILE_WIDTH = 8;
+		static constexpr uint32_t TILE_HEIGHT = 4;
+
+		ObtOcclusionCuller(uint32_t width = 256, uint32_t height = 128);
+
+		ObtOcclusionCuller(const ObtOcclusionCuller&) = delete;
+		ObtOcclusionCuller &operator=(const ObtOcclusionCuller&) = delete;
+
+		void clear();
+		void renderOccluder(const glm::mat4& clipFromModel, const glm::vec3* positions, const uint32_t* indices, uint32_t indexCount);
+		bool isVisible(const glm::mat4& clipFromWorld, const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+
+		uint32_t getWidth() const { return width; }
+		uint32_t getHeight() const { return height; }
+
+	private:
+		uint32_t width;
+		uint32_t height;
+		uint32_t tilesPerRow;
+		uint32_t tileRows;
+
+		std::vector<float> referenceDepths;
+		std::vector<float> workingDepths;
+		std::vector<uint32_t> coverageMasks;
+};
+
+}
@@ -41,8 +41,8 @@ void ObtPipeline::createGraphicsPipeline(const std::string& vertPath, const std:
 
 	auto vertCode = readFile(vertPath);
 	auto fragCode = readFile(fragPath);
-	createShaderModule(vertCode, &vertShaderModule);
-	createShaderModule(fragCode, &fragShaderModule);
+	createShaderModule(obtDevice, vertCode, &vertShaderModule);
+	createShaderModule(obtDevice, fragCode, &fragShaderModule);
 
 	VkPipelineShaderStageCreateInfo shaderStages[2];
 	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -94,13 +94,13 @@ void ObtPipeline::createGraphicsPipeline(const std::string& vertPath, const std:
 	}
 }
 
-void ObtPipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) {
+void ObtPipeline::createShaderModule(ObtDevice& device, const std::vector<char>& code, VkShaderModule* shaderModule) {
 	VkShaderModuleCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 	createInfo.codeSize = code.size();
 	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
 
-	if (vkCreateShaderModule(obtDevice.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
+	if (vkCreateShaderModule(device.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create shader module!");
 	}
 }
@@ -177,4 +177,37 @@ void ObtPipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
 	configInfo.dynamicStateInfo.flags = 0;
 }
 
+ObtComputePipeline::ObtComputePipeline(ObtDevice& device, const std::string& compPath, VkPipelineLayout pipelineLayout) : obtDevice{device} {
+	assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline without a pipelineLayout");
+
+	auto compCode = ObtPipeline::readFile(compPath);
+	ObtPipeline::createShaderModule(obtDevice, compCode, &compShaderModule);
+
+	VkPipelineShaderStageCreateInfo shaderStage{};
+	shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	shaderStage.module = compShaderModule;
+	shaderStage.pName = "main";
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = shaderStage;
+	pipelineInfo.layout = pipelineLayout;
+	pipelineInfo.basePipelineIndex = -1;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+	if (vkCreateComputePipelines(obtDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create compute pipeline!");
+	}
+}
+
+ObtComputePipeline::~ObtComputePipeline() {
+	vkDestroyShaderModule(obtDevice.device(), compShaderModule, nullptr);
+	vkDestroyPipeline(obtDevice.device(), computePipeline, nullptr);
+}
+
+void ObtComputePipeline::bind(VkCommandBuffer commandBuffer) {
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+}
+
 }
@@ -37,11 +37,11 @@ class ObtPipeline {
 		void bind(VkCommandBuffer commandBuffer);
 		static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 
-	private:
 		static std::vector<char> readFile(const std::string& path);
+		static void createShaderModule(ObtDevice& device, const std::vector<char>& code, VkShaderModule* shaderModule);
 
+	private:
 		void createGraphicsPipeline(const std::string& vertPath, const std::string& fragPath, const PipelineConfigInfo& configInfo);
-		void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
 
 		ObtDevice& obtDevice;
 		VkPipeline graphicsPipeline;
@@ -50,4 +50,20 @@ class ObtPipeline {
 		VkShaderModule fragShaderModule;
 };
 
+class ObtComputePipeline {
+	public:
+		ObtComputePipeline(ObtDevice& device, const std::string& compPath, VkPipelineLayout pipelineLayout);
+		~ObtComputePipeline();
+
+		ObtComputePipeline(const ObtComputePipeline&) = delete;
+		ObtComputePipeline &operator=(const ObtComputePipeline&) = delete;
+
+		void bind(VkCommandBuffer commandBuffer);
+
+	private:
+		ObtDevice& obtDevice;
+		VkPipeline computePipeline;
+		VkShaderModule compShaderModule;
+};
+
 }
@@ -5,15 +5,29 @@
 
 namespace obt {
 
-ObtRenderer::ObtRenderer(ObtWindow& window, ObtDevice& device) : obtWindow{window}, obtDevice{device} {
+ObtRenderer::ObtRenderer(ObtWindow& window, ObtDevice& device, uint32_t recordingThreadCount)
+	: obtWindow{window}, obtDevice{device}, recordingThreadCount{std::max(recordingThreadCount, 1u)} {
 	recreateSwapchain();
-	createCommandBuffers();
+	commandPools = std::make_unique<ObtCommandPools>(obtDevice, ObtSwapChain::MAX_FRAMES_IN_FLIGHT, this->recordingThreadCount);
 }
 
-ObtRenderer::~ObtRenderer() {
-	freeCommandBuffers();
+/**
+ * Switches between recording secondary command buffers every frame and reusing them while their
+ * content key stays the same, the cache pools are created on first use
+ */
+void ObtRenderer::setCommandCachingEnabled(bool enabled) {
+	if (enabled && cachedCommandPools == nullptr) {
+		cachedCommandPools = std::make_unique<ObtCommandPools>(obtDevice, ObtSwapChain::MAX_FRAMES_IN_FLIGHT, recordingThreadCount);
+		cachedCommands.resize(ObtSwapChain::MAX_FRAMES_IN_FLIGHT);
+	}
+	for (auto& cached : cachedCommands) {
+		cached.valid = false;
+	}
+	commandCachingEnabled = enabled;
 }
 
+ObtRenderer::~ObtRenderer() {}
+
 void ObtRenderer::recreateSwapchain() {
 	auto extent = obtWindow.getExtent();
 	while (extent.width == 0 || extent.height == 0) {
@@ -21,7 +35,7 @@ void ObtRenderer::recreateSwapchain() {
 		glfwWaitEvents();
 	}
 
-	vkDeviceWaitIdle(obtDevice.device());
+	obtDevice.waitIdle();
 
 	if (obtSwapChain == nullptr) {
 		obtSwapChain = std::make_unique<ObtSwapChain>(obtDevice, extent);
@@ -33,25 +47,39 @@ void ObtRenderer::recreateSwapchain() {
 			throw std::runtime_error("Swap chain image foramt has changed!");
 		}
 	}
+	swapChainVersion++;
 }
 
-void ObtRenderer::createCommandBuffers() {
-	commandBuffers.resize(ObtSwapChain::MAX_FRAMES_IN_FLIGHT);
+/**
+ * Begins the next reserved secondary command buffer of a thread's pool, only ever called from that
+ * thread while recording
+ *
+ * @param cached Buffers that are executed in later frames are not one time submit and leave the
+ * framebuffer out of their inheritance, so they are valid for whichever swap chain image is drawn
+ * @param threadIndex Index of the calling thread, below the recording thread count
+ * @param commandBuffer Receives the command buffer, with viewport and scissor already set
+ */
+VkResult ObtRenderer::beginSecondaryCommandBuffer(ObtCommandPools& pools, bool cached, uint32_t threadIndex, VkCommandBuffer& commandBuffer) {
+	commandBuffer = pools.acquire(currentFrameIndex, threadIndex, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = obtSwapChain->getRenderPass();
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = cached ? VK_NULL_HANDLE : obtSwapChain->getFrameBuffer(currentImageIndex);
 
-	VkCommandBufferAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = obtDevice.getCommandPool();
-	allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	if (!cached) beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
 
-	if (vkAllocateCommandBuffers(obtDevice.device(), &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to allocate command buffers!");
-	}
-}
+	VkResult result = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+	if (result != VK_SUCCESS) return result;
 
-void ObtRenderer::freeCommandBuffers() {
-	vkFreeCommandBuffers(obtDevice.device(), obtDevice.getCommandPool(), static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
-	commandBuffers.clear();
+	// Dynamic state is not inherited from the primary command buffer
+	setViewportAndScissor(commandBuffer);
+	return VK_SUCCESS;
 }
 
 VkCommandBuffer ObtRenderer::beginFrame() {
@@ -70,6 +98,11 @@ VkCommandBuffer ObtRenderer::beginFrame() {
 
 	isFrameStarted = true;
 
+	// The frame's fence was waited on while acquiring, so all of its command buffers are done
+	// executing and are recycled by resetting the frame's pools at once
+	commandPools->reset(currentFrameIndex);
+	currentCommandBuffer = commandPools->acquire(currentFrameIndex, 0, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
 	auto commandBuffer = getCurrentCommandBuffer();
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -101,7 +134,11 @@ void ObtRenderer::endFrame() {
 	currentFrameIndex = (currentFrameIndex+1)%ObtSwapChain::MAX_FRAMES_IN_FLIGHT;
 }
 
-void ObtRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
+/**
+ * @param contents VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS when the pass is recorded with
+ * recordSecondary, the primary buffer may then only execute secondary buffers until the pass ends
+ */
+void ObtRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents) {
 	assert(isFrameStarted && "Cannot call beginSwapChainRenderPass while frame is not in progress!");
 	assert(commandBuffer == getCurrentCommandBuffer() && "Cannot begin render pass on a command buffer from a different frame!");
 
@@ -119,8 +156,14 @@ void ObtRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
 	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 	renderPassInfo.pClearValues = clearValues.data();
 
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+
+	if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+		setViewportAndScissor(commandBuffer);
+	}
+}
 
+void ObtRenderer::setViewportAndScissor(VkCommandBuffer commandBuffer) {
 	VkViewport viewport{};
 	viewport.x = 0.f;
 	viewport.y = 0.f;
@@ -4,8 +4,15 @@
 #include "obt_device.hpp"
 #include "obt_swap_chain.hpp"
 #include "obt_model.hpp"
+#include "obt_job_system.hpp"
+#include "obt_command_pools.hpp"
+#include "obt_utils.hpp"
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
+#include <stdexcept>
+#include <type_traits>
 #include <vector>
 #include <cassert>
 
@@ -13,7 +20,7 @@ namespace obt {
 
 class ObtRenderer {
 	public:
-		ObtRenderer(ObtWindow& window, ObtDevice& device);
+		ObtRenderer(ObtWindow& window, ObtDevice& device, uint32_t recordingThreadCount = 1);
 		~ObtRenderer();
 
 		ObtRenderer(const ObtRenderer&) = delete;
@@ -21,11 +28,12 @@ class ObtRenderer {
 
 		VkRenderPass getSwapChainRenderPass() const { return obtSwapChain->getRenderPass(); }
 		float getAspectRation() const { return obtSwapChain->extentAspectRatio(); }
+		VkExtent2D getSwapChainExtent() const { return obtSwapChain->getSwapChainExtent(); }
 		bool isFrameInProgress() const { return isFrameStarted; }
 
 		VkCommandBuffer getCurrentCommandBuffer() const {
 			assert(isFrameStarted && "Cannot get command buffer when frame is not in progress!");
-			return commandBuffers[currentFrameIndex];
+			return currentCommandBuffer;
 		}
 
 		int getFrameIndex() const {
@@ -33,20 +41,161 @@ class ObtRenderer {
 			return currentFrameIndex;
 		}
 
+		// Depth of the image being rendered, left in depth read only layout once the pass ends
+		VkImageView getCurrentDepthImageView() const {
+			assert(isFrameStarted && "Cannot get depth image view when frame is not in progress!");
+			return obtSwapChain->getDepthImageView(currentImageIndex);
+		}
+
 		VkCommandBuffer beginFrame();
 		void endFrame();
-		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 		void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
+		// Splits [0, count) into chunks of at most grainSize that the job system records in parallel,
+		// record(secondaryCommandBuffer, begin, end) is called for each chunk with a secondary command
+		// buffer continuing the swap chain render pass, which must have been begun with
+		// VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS. The primary buffer executes them in chunk order.
+		//
+		// The job system may have at most as many threads as the renderer was created with, the thread
+		// driving the frame must have thread index 0.
+		template<typename F>
+		void recordSecondary(VkCommandBuffer commandBuffer, ObtJobSystem& jobSystem, uint32_t count, uint32_t grainSize, F&& record) {
+			recordChunks(*commandPools, false, jobSystem, count, grainSize, record, secondaryCommandBuffers);
+			if (!secondaryCommandBuffers.empty()) {
+				vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryCommandBuffers.size()), secondaryCommandBuffers.data());
+			}
+		}
+
+		// Everything record() bakes into cached commands, kept as words next to their hash. The hash
+		// rejects most changes early, matching words are still compared one by one so a collision
+		// cannot replay commands recorded for other content.
+		class CommandContent {
+			public:
+				void clear() {
+					words.clear();
+					hash = 0;
+				}
+
+				// Integers, enums and handles, pointers and dispatchable handles by address
+				template<typename... T>
+				void add(const T&... values) { (addWord(values), ...); }
+
+				bool operator==(const CommandContent& other) const { return hash == other.hash && words == other.words; }
+				bool operator!=(const CommandContent& other) const { return !(*this == other); }
+
+			private:
+				template<typename T>
+				void addWord(const T& value) {
+					uint64_t word;
+					if constexpr (std::is_pointer_v<T>) {
+						word = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value));
+					} else {
+						word = static_cast<uint64_t>(value);
+					}
+					words.push_back(word);
+					hashCombine(hash, word);
+				}
+
+				std::vector<uint64_t> words;
+				std::size_t hash = 0;
+		};
+
+		// Like recordSecondary, but with command caching enabled the secondary command buffers are
+		// kept for the frame in flight and executed again while content stays the same and the swap
+		// chain was not recreated. The content must change whenever anything record() would bake into
+		// the commands changes, including resources that were replaced or moved.
+		//
+		// Returns true if record() was called, false if cached commands were executed.
+		template<typename F>
+		bool recordSecondaryCached(VkCommandBuffer commandBuffer, ObtJobSystem& jobSystem, uint32_t count, uint32_t grainSize, const CommandContent& content, F&& record) {
+			if (!commandCachingEnabled) {
+				recordSecondary(commandBuffer, jobSystem, count, grainSize, record);
+				return true;
+			}
+
+			CachedCommands& cached = cachedCommands[currentFrameIndex];
+			bool hit = cached.valid && cached.swapChainVersion == swapChainVersion && cached.content == content;
+			if (!hit) {
+				// The frame's fence was waited on, so its previous cached buffers are done executing
+				cached.valid = false;
+				cachedCommandPools->reset(currentFrameIndex);
+				recordChunks(*cachedCommandPools, true, jobSystem, count, grainSize, record, cached.commandBuffers);
+				cached.content = content;
+				cached.swapChainVersion = swapChainVersion;
+				cached.valid = true;
+			}
+
+			if (!cached.commandBuffers.empty()) {
+				vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(cached.commandBuffers.size()), cached.commandBuffers.data());
+			}
+			return !hit;
+		}
+
+		// Caching only pays off when frames often record the same commands, e.g. a mostly static scene
+		void setCommandCachingEnabled(bool enabled);
+		bool isCommandCachingEnabled() const { return commandCachingEnabled; }
+
 	private:
-		void createCommandBuffers();
-		void freeCommandBuffers();
+		// Secondary command buffers of one frame in flight that are executed until their key changes
+		struct CachedCommands {
+			std::vector<VkCommandBuffer> commandBuffers;
+			CommandContent content;
+			uint32_t swapChainVersion = 0;
+			bool valid = false;
+		};
+
 		void recreateSwapchain();
+		void setViewportAndScissor(VkCommandBuffer commandBuffer);
+
+		VkResult beginSecondaryCommandBuffer(ObtCommandPools& pools, bool cached, uint32_t threadIndex, VkCommandBuffer& commandBuffer);
+
+		template<typename F>
+		void recordChunks(ObtCommandPools& pools, bool cached, ObtJobSystem& jobSystem, uint32_t count, uint32_t grainSize, F& record, std::vector<VkCommandBuffer>& chunks) {
+			assert(jobSystem.getThreadCount() <= recordingThreadCount && "Job system has more threads than the renderer records with!");
+			chunks.clear();
+			if (count == 0) return;
+
+			grainSize = std::max(grainSize, 1u);
+			uint32_t chunkCount = (count + grainSize - 1) / grainSize;
+			pools.reserve(currentFrameIndex, VK_COMMAND_BUFFER_LEVEL_SECONDARY, chunkCount);
+			chunks.assign(chunkCount, VK_NULL_HANDLE);
+
+			// Jobs must not throw, failures are reported once every chunk is done
+			std::atomic<bool> failed{false};
+			jobSystem.parallelFor(count, grainSize, [&](uint32_t begin, uint32_t end) {
+				VkCommandBuffer secondaryCommandBuffer = VK_NULL_HANDLE;
+				if (beginSecondaryCommandBuffer(pools, cached, jobSystem.getThreadIndex(), secondaryCommandBuffer) != VK_SUCCESS) {
+					failed.store(true, std::memory_order_relaxed);
+					return;
+				}
+				record(secondaryCommandBuffer, begin, end);
+				if (vkEndCommandBuffer(secondaryCommandBuffer) != VK_SUCCESS) {
+					failed.store(true, std::memory_order_relaxed);
+				}
+				chunks[begin / grainSize] = secondaryCommandBuffer;
+			});
+			if (failed.load(std::memory_order_relaxed)) {
+				chunks.clear();
+				throw std::runtime_error("Failed to record secondary command buffer!");
+			}
+		}
 
 		ObtWindow& obtWindow;
 		ObtDevice& obtDevice;
 		std::unique_ptr<ObtSwapChain> obtSwapChain;
-		std::vector<VkCommandBuffer> commandBuffers;
+
+		// Primary and secondary command buffers of every frame in flight and recording thread
+		uint32_t recordingThreadCount;
+		std::unique_ptr<ObtCommandPools> commandPools;
+		VkCommandBuffer currentCommandBuffer = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> secondaryCommandBuffers;
+
+		// Cached secondary buffers live in their own pools, which are only reset when re-recording
+		bool commandCachingEnabled = false;
+		std::unique_ptr<ObtCommandPools> cachedCommandPools;
+		std::vector<CachedCommands> cachedCommands;
+		uint32_t swapChainVersion = 0;
 
 		uint32_t currentImageIndex;
 		int currentFrameIndex = 0;
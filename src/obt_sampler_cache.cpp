@@ -0,0 +1,59 @@
+#include "obt_sampler_cache.hpp"
+
+#include "obt_utils.hpp"
+
+#include <algorithm>
+
+namespace obt {
+
+size_t ObtSamplerInfoHash::operator()(const ObtSamplerInfo& info) const {
+	size_t seed = 0;
+	hashCombine(seed, info.magFilter, info.minFilter, info.mipmapMode, info.addressModeU, info.addressModeV, info.addressModeW,
+		info.anisotropyEnable, info.maxAnisotropy, info.mipLodBias, info.minLod, info.maxLod, info.borderColor, info.compareEnable, info.compareOp);
+	return seed;
+}
+
+/**
+ * Returns a sampler matching the given state, creating it only the first time that state is seen
+ *
+ * @param samplerInfo Full sampler state used as the cache key
+ *
+ * @return Shared handle to the sampler, valid for as long as any holder keeps it
+ */
+std::shared_ptr<ObtSampler> ObtSamplerCache::getSampler(const ObtSamplerInfo& samplerInfo) {
+	ObtSamplerInfo key = normalize(samplerInfo);
+
+	auto it = samplers.find(key);
+	if (it != samplers.end()) return it->second;
+
+	auto sampler = std::make_shared<ObtSampler>(obtDevice, key);
+	samplers.emplace(key, sampler);
+	return sampler;
+}
+
+/**
+ * Destroys the samplers that are no longer referenced outside of the cache
+ */
+void ObtSamplerCache::releaseUnused() {
+	for (auto it = samplers.begin(); it != samplers.end();) {
+		if (it->second.use_count() == 1) {
+			it = samplers.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+// States that produce the same VkSampler must also produce the same key
+ObtSamplerInfo ObtSamplerCache::normalize(const ObtSamplerInfo& samplerInfo) const {
+	ObtSamplerInfo key = samplerInfo;
+	if (key.anisotropyEnable) {
+		key.maxAnisotropy = std::min(key.maxAnisotropy, obtDevice.properties.limits.maxSamplerAnisotropy);
+	} else {
+		key.maxAnisotropy = 1.f;
+	}
+	if (!key.compareEnable) key.compareOp = VK_COMPARE_OP_ALWAYS;
+	return key;
+}
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "obt_device.hpp"
+#include "obt_image.hpp"
+
+#include <memory>
+#include <unordered_map>
+
+namespace obt {
+
+struct ObtSamplerInfoHash {
+	size_t operator()(const ObtSamplerInfo& info) const;
+};
+
+class ObtSamplerCache {
+	public:
+		ObtSamplerCache(ObtDevice& obtDevice) : obtDevice{obtDevice} {}
+
+		ObtSamplerCache(const ObtSamplerCache&) = delete;
+		ObtSamplerCache &operator=(const ObtSamplerCache&) = delete;
+
+		std::shared_ptr<ObtSampler> getSampler(const ObtSamplerInfo& samplerInfo = ObtSamplerInfo{});
+		void releaseUnused();
+
+		size_t size() const { return samplers.size(); }
+
+	private:
+		ObtSamplerInfo normalize(const ObtSamplerInfo& samplerInfo) const;
+
+		ObtDevice& obtDevice;
+		std::unordered_map<ObtSamplerInfo, std::shared_ptr<ObtSampler>, ObtSamplerInfoHash> samplers;
+};
+
+}
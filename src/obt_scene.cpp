@@ -0,0 +1,396 @@
+#include "obt_scene.hpp"
+
+#include "obt_transform_batch.hpp"
+#include "obt_job_system.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace obt {
+
+ObtScene::model_id_t ObtScene::addModel(std::shared_ptr<ObtModel> model) {
+	models.push_back(std::move(model));
+	structureVersion++;
+	return static_cast<model_id_t>(models.size() - 1);
+}
+
+/**
+ * Creates an object at the identity transform
+ *
+ * @param model Model drawn for the object
+ * @param parent Object the new one is attached to, an invalid handle creates a root
+ */
+ObtSceneHandle ObtScene::create(model_id_t model, ObtSceneHandle parent) {
+	uint32_t parentIndex = isValid(parent) ? indexOf(parent) : NO_PARENT;
+	uint32_t depth = parentIndex == NO_PARENT ? 0 : depths[parentIndex] + 1;
+
+	uint32_t slot;
+	if (!freeSlots.empty()) {
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	} else {
+		slot = static_cast<uint32_t>(slots.size());
+		slots.emplace_back();
+	}
+
+	uint32_t index = size();
+	slots[slot].dense = index;
+	translations.emplace_back(0.f);
+	rotations.emplace_back(1.f, 0.f, 0.f, 0.f);
+	scales.emplace_back(1.f);
+	modelIds.push_back(model);
+	objectFlags.push_back(FLAG_VISIBLE);
+	parents.push_back(parentIndex);
+	depths.push_back(depth);
+	transformDirty.push_back(0);
+	worldTransforms.emplace_back();
+	worldBounds.emplace_back(0.f);
+	denseToSlot.push_back(slot);
+	markDirty(index);
+	bvhDirty = true;
+	structureVersion++;
+
+	// Appending keeps the breadth first order only when the object lands in the deepest level
+	uint32_t levelCount = getLevelCount();
+	if (depth + 1 == levelCount) {
+		levelOffsets.back() = size();
+	} else if (depth == levelCount) {
+		levelOffsets.push_back(size());
+	} else {
+		orderDirty = true;
+	}
+
+	return ObtSceneHandle{slot, slots[slot].generation};
+}
+
+/**
+ * Removes an object together with all of its descendants
+ *
+ * @note The remaining objects keep their relative order, so dense indices after the removed ones
+ * shift down and the cost is linear in the scene size. Handles stay valid.
+ */
+void ObtScene::destroy(ObtSceneHandle handle) {
+	// Descendants are only guaranteed to follow their ancestors in a rebuilt order
+	if (orderDirty) {
+		rebuildOrder();
+	}
+
+	uint32_t index = indexOf(handle);
+	std::vector<uint32_t> remap(size(), NO_PARENT);
+
+	uint32_t kept = index;
+	for (uint32_t i = 0; i < index; i++) {
+		remap[i] = i;
+	}
+	for (uint32_t i = index; i < size(); i++) {
+		bool removed = i == index || (parents[i] != NO_PARENT && remap[parents[i]] == NO_PARENT);
+		if (removed) {
+			Slot& slot = slots[denseToSlot[i]];
+			slot.dense = ObtSceneHandle::INVALID_INDEX;
+			slot.generation++;
+			slot.pendingUploads = 0;
+			freeSlots.push_back(denseToSlot[i]);
+			continue;
+		}
+
+		remap[i] = kept;
+		translations[kept] = translations[i];
+		rotations[kept] = rotations[i];
+		scales[kept] = scales[i];
+		modelIds[kept] = modelIds[i];
+		objectFlags[kept] = objectFlags[i];
+		parents[kept] = parents[i] == NO_PARENT ? NO_PARENT : remap[parents[i]];
+		depths[kept] = depths[i];
+		transformDirty[kept] = transformDirty[i];
+		worldTransforms[kept] = worldTransforms[i];
+		worldBounds[kept] = worldBounds[i];
+		denseToSlot[kept] = denseToSlot[i];
+		slots[denseToSlot[kept]].dense = kept;
+
+		// Shifted objects now live in a different slot of the uploaded arrays
+		markDirty(kept);
+		kept++;
+	}
+
+	translations.resize(kept);
+	rotations.resize(kept);
+	scales.resize(kept);
+	modelIds.resize(kept);
+	objectFlags.resize(kept);
+	parents.resize(kept);
+	depths.resize(kept);
+	transformDirty.resize(kept);
+	worldTransforms.resize(kept);
+	worldBounds.resize(kept);
+	denseToSlot.resize(kept);
+
+	rebuildLevels();
+	bvhDirty = true;
+	structureVersion++;
+}
+
+bool ObtScene::isValid(ObtSceneHandle handle) const {
+	return handle.index < slots.size() && slots[handle.index].generation == handle.generation && slots[handle.index].dense != ObtSceneHandle::INVALID_INDEX;
+}
+
+/**
+ * Attaches an object to a new parent, its local transform is kept as is
+ *
+ * @param parent New parent, an invalid handle turns the object into a root
+ */
+void ObtScene::setParent(ObtSceneHandle handle, ObtSceneHandle parent) {
+	uint32_t index = indexOf(handle);
+	uint32_t parentIndex = isValid(parent) ? indexOf(parent) : NO_PARENT;
+
+	for (uint32_t ancestor = parentIndex; ancestor != NO_PARENT; ancestor = parents[ancestor]) {
+		assert(ancestor != index && "Cannot parent an object to its own descendant");
+	}
+
+	parents[index] = parentIndex;
+	markDirty(index);
+	orderDirty = true;
+}
+
+ObtSceneHandle ObtScene::getParent(ObtSceneHandle handle) const {
+	uint32_t parentIndex = parents[indexOf(handle)];
+	return parentIndex == NO_PARENT ? ObtSceneHandle{} : handleAt(parentIndex);
+}
+
+uint32_t ObtScene::markDirty(uint32_t index) {
+	transformDirty[index] = 1;
+	transformsDirty = true;
+	return index;
+}
+
+void ObtScene::markChanged(uint32_t slot) {
+	slots[slot].pendingUploads = framesInFlight;
+	if (!slots[slot].queued) {
+		slots[slot].queued = true;
+		changedSlots.push_back(slot);
+	}
+}
+
+template<typename T>
+void ObtScene::permute(std::vector<T>& values, const std::vector<uint32_t>& order) {
+	std::vector<T> permuted;
+	permuted.reserve(values.size());
+	for (uint32_t index : order) {
+		permuted.push_back(values[index]);
+	}
+	values.swap(permuted);
+}
+
+/**
+ * Sorts the dense arrays into breadth first order, roots keep their relative order and children
+ * follow in the order of their parents
+ */
+void ObtScene::rebuildOrder() {
+	uint32_t count = size();
+
+	// Children grouped by parent, counting sort on the parent index
+	std::vector<uint32_t> childOffsets(count + 1, 0);
+	for (uint32_t i = 0; i < count; i++) {
+		if (parents[i] != NO_PARENT) childOffsets[parents[i] + 1]++;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		childOffsets[i + 1] += childOffsets[i];
+	}
+	std::vector<uint32_t> children(childOffsets[count]);
+	std::vector<uint32_t> cursor(childOffsets.begin(), childOffsets.end() - 1);
+	for (uint32_t i = 0; i < count; i++) {
+		if (parents[i] != NO_PARENT) children[cursor[parents[i]]++] = i;
+	}
+
+	std::vector<uint32_t> order;
+	order.reserve(count);
+	for (uint32_t i = 0; i < count; i++) {
+		if (parents[i] == NO_PARENT) order.push_back(i);
+	}
+	for (uint32_t head = 0; head < order.size(); head++) {
+		uint32_t parent = order[head];
+		order.insert(order.end(), children.begin() + childOffsets[parent], children.begin() + childOffsets[parent + 1]);
+	}
+	assert(order.size() == count && "Scene hierarchy contains a cycle");
+
+	std::vector<uint32_t> remap(count);
+	for (uint32_t i = 0; i < count; i++) {
+		remap[order[i]] = i;
+	}
+
+	permute(translations, order);
+	permute(rotations, order);
+	permute(scales, order);
+	permute(modelIds, order);
+	permute(objectFlags, order);
+	permute(parents, order);
+	permute(transformDirty, order);
+	permute(worldTransforms, order);
+	permute(worldBounds, order);
+	permute(denseToSlot, order);
+
+	for (uint32_t i = 0; i < count; i++) {
+		slots[denseToSlot[i]].dense = i;
+		if (parents[i] != NO_PARENT) parents[i] = remap[parents[i]];
+		depths[i] = parents[i] == NO_PARENT ? 0 : depths[parents[i]] + 1;
+		if (order[i] != i) markDirty(i);
+	}
+
+	rebuildLevels();
+	orderDirty = false;
+	bvhDirty = true;
+}
+
+void ObtScene::rebuildLevels() {
+	levelOffsets.assign(1, 0);
+	for (uint32_t i = 0; i < size(); i++) {
+		while (depths[i] >= levelOffsets.size()) {
+			levelOffsets.push_back(i);
+		}
+	}
+	if (size() > 0) {
+		levelOffsets.push_back(size());
+	}
+}
+
+/**
+ * Recomputes the world transforms of every changed object and everything below it, one level of
+ * the hierarchy at a time so parents are always final before their children read them
+ *
+ * @param jobSystem When set, each level is split into ranges that are updated in parallel
+ */
+void ObtScene::updateTransforms(ObtJobSystem* jobSystem) {
+	if (orderDirty) {
+		rebuildOrder();
+	}
+	if (!transformsDirty) {
+		updateBvh(false, jobSystem);
+		return;
+	}
+
+	for (uint32_t level = 0; level < getLevelCount(); level++) {
+		uint32_t begin = getLevelBegin(level);
+		uint32_t end = getLevelEnd(level);
+		if (jobSystem != nullptr) {
+			jobSystem->parallelFor(end - begin, TRANSFORM_GRAIN_SIZE, [this, begin](uint32_t first, uint32_t last) {
+				updateLevel(begin + first, begin + last);
+			});
+		} else {
+			updateLevel(begin, end);
+		}
+	}
+
+	for (uint32_t i = 0; i < size(); i++) {
+		if (transformDirty[i]) markChanged(denseToSlot[i]);
+	}
+	std::fill(transformDirty.begin(), transformDirty.end(), 0);
+	transformsDirty = false;
+	updateBvh(true, jobSystem);
+}
+
+/**
+ * Rebuilds the hierarchy when the set or order of objects changed or refitting has made it too
+ * expensive to query, otherwise refits it to the new bounds
+ */
+void ObtScene::updateBvh(bool boundsChanged, ObtJobSystem* jobSystem) {
+	if (bvhDirty || bvh.needsRebuild()) {
+		bvh.build(worldBounds.data(), size(), jobSystem);
+		bvhDirty = false;
+	} else if (boundsChanged) {
+		bvh.refit(worldBounds.data(), jobSystem);
+	}
+}
+
+/**
+ * Updates one contiguous range of a single level, only reads the level above so ranges of the same
+ * level are independent of each other
+ */
+void ObtScene::updateLevel(uint32_t begin, uint32_t end) {
+	for (uint32_t i = begin; i < end; i++) {
+		if (parents[i] != NO_PARENT && transformDirty[parents[i]]) transformDirty[i] = 1;
+	}
+
+	for (uint32_t i = begin; i < end;) {
+		if (!transformDirty[i]) {
+			i++;
+			continue;
+		}
+
+		uint32_t first = i;
+		while (i < end && transformDirty[i]) i++;
+		computeTransformMatrices(&translations[first], &rotations[first], &scales[first], i - first,
+			&worldTransforms[first].modelMatrix, &worldTransforms[first].normalMatrix, sizeof(ObtWorldTransform));
+
+		for (uint32_t j = first; j < i; j++) {
+			if (parents[j] != NO_PARENT) {
+				// The inverse transpose of a product is the product of the inverse transposes
+				const ObtWorldTransform& parent = worldTransforms[parents[j]];
+				worldTransforms[j].modelMatrix = parent.modelMatrix * worldTransforms[j].modelMatrix;
+				worldTransforms[j].normalMatrix = parent.normalMatrix * worldTransforms[j].normalMatrix;
+			}
+			updateBounds(j);
+		}
+	}
+}
+
+/**
+ * Moves the model's bounding sphere to world space, scaled by the largest axis scale so it still
+ * encloses the model under non-uniform scale. Objects without a model get an infinitely negative
+ * radius which fails every frustum test.
+ */
+void ObtScene::updateBounds(uint32_t index) {
+	ObtModel* model = getModel(modelIds[index]);
+	if (model == nullptr) {
+		worldBounds[index] = glm::vec4{0.f, 0.f, 0.f, -std::numeric_limits<float>::infinity()};
+		return;
+	}
+
+	const glm::mat4& modelMatrix = worldTransforms[index].modelMatrix;
+	const glm::vec4& sphere = model->getBoundingSphere();
+	glm::vec3 center{modelMatrix * glm::vec4{glm::vec3{sphere}, 1.f}};
+	float scaleSquared = std::max({
+		glm::dot(glm::vec3{modelMatrix[0]}, glm::vec3{modelMatrix[0]}),
+		glm::dot(glm::vec3{modelMatrix[1]}, glm::vec3{modelMatrix[1]}),
+		glm::dot(glm::vec3{modelMatrix[2]}, glm::vec3{modelMatrix[2]})
+	});
+	worldBounds[index] = glm::vec4{center, sphere.w * std::sqrt(scaleSquared)};
+}
+
+/**
+ * Returns the dense indices of objects whose world transform changed since the current frame in
+ * flight last uploaded them, must be called exactly once per frame after updateTransforms since
+ * every frame in flight keeps its own copy of the object data
+ *
+ * @param indices Filled with the changed indices in ascending order
+ */
+void ObtScene::collectChanges(std::vector<uint32_t>& indices) {
+	indices.clear();
+
+	size_t kept = 0;
+	for (uint32_t slot : changedSlots) {
+		Slot& entry = slots[slot];
+		// Destroyed objects leave their entry behind until it is collected here
+		if (entry.dense == ObtSceneHandle::INVALID_INDEX || entry.pendingUploads == 0) {
+			entry.queued = false;
+			continue;
+		}
+
+		indices.push_back(entry.dense);
+		if (--entry.pendingUploads > 0) {
+			changedSlots[kept++] = slot;
+		} else {
+			entry.queued = false;
+		}
+	}
+	changedSlots.resize(kept);
+
+	std::sort(indices.begin(), indices.end());
+}
+
+uint32_t ObtScene::indexOf(ObtSceneHandle handle) const {
+	assert(isValid(handle) && "Stale or invalid scene handle");
+	return slots[handle.index].dense;
+}
+
+}
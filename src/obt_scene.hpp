@@ -0,0 +1,152 @@
+#pragma once
+
+#include "obt_bvh.hpp"
+#include "obt_model.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace obt {
+
+class ObtJobSystem;
+
+struct ObtSceneHandle {
+	static constexpr uint32_t INVALID_INDEX = ~0u;
+
+	uint32_t index = INVALID_INDEX;
+	uint32_t generation = 0;
+
+	bool operator==(const ObtSceneHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const ObtSceneHandle& other) const { return !(*this == other); }
+};
+
+struct ObtWorldTransform {
+	glm::mat4 modelMatrix{1.f};
+	glm::mat4 normalMatrix{1.f};
+};
+
+// Structure of arrays scene store, objects live in dense arrays that per-frame passes stream
+// through and are addressed from outside by generational handles that stay valid across removals.
+// Changes are tracked per object so each frame in flight only re-uploads what moved since it last
+// uploaded.
+//
+// Objects may have a parent, the dense arrays are kept in breadth first order so parents always
+// come before their children and every depth of the hierarchy is one contiguous range. World
+// transforms are then updated one level at a time in a single forward sweep.
+//
+// A bounding volume hierarchy over the world bounds is maintained alongside, refit after objects
+// move and rebuilt when objects are added, removed or reordered or the refits degraded it.
+class ObtScene {
+	public:
+		using model_id_t = uint32_t;
+
+		static constexpr uint32_t FLAG_VISIBLE = 1u << 0;
+		// Rasterized into the occlusion buffer when visible, the model needs an occluder mesh
+		static constexpr uint32_t FLAG_OCCLUDER = 1u << 1;
+		static constexpr model_id_t NO_MODEL = ~0u;
+		static constexpr uint32_t NO_PARENT = ~0u;
+		static constexpr uint32_t TRANSFORM_GRAIN_SIZE = 1024;
+
+		ObtScene(uint32_t framesInFlight = 1) : framesInFlight{framesInFlight} {}
+
+		ObtScene(const ObtScene&) = delete;
+		ObtScene &operator=(const ObtScene&) = delete;
+
+		model_id_t addModel(std::shared_ptr<ObtModel> model);
+		ObtModel* getModel(model_id_t id) const { return id == NO_MODEL ? nullptr : models[id].get(); }
+		uint32_t getModelCount() const { return static_cast<uint32_t>(models.size()); }
+
+		ObtSceneHandle create(model_id_t model = NO_MODEL, ObtSceneHandle parent = {});
+		void destroy(ObtSceneHandle handle);
+		bool isValid(ObtSceneHandle handle) const;
+
+		void setParent(ObtSceneHandle handle, ObtSceneHandle parent);
+		ObtSceneHandle getParent(ObtSceneHandle handle) const;
+
+		uint32_t size() const { return static_cast<uint32_t>(translations.size()); }
+		uint32_t indexOf(ObtSceneHandle handle) const;
+		ObtSceneHandle handleAt(uint32_t index) const { return ObtSceneHandle{denseToSlot[index], slots[denseToSlot[index]].generation}; }
+
+		// Mutable transform and model access marks the object and its subtree as changed, the
+		// values are relative to the parent. Flag access only marks the object itself.
+		glm::vec3& translation(ObtSceneHandle handle) { return translations[markDirty(indexOf(handle))]; }
+		glm::quat& rotation(ObtSceneHandle handle) { return rotations[markDirty(indexOf(handle))]; }
+		glm::vec3& scale(ObtSceneHandle handle) { return scales[markDirty(indexOf(handle))]; }
+		model_id_t& model(ObtSceneHandle handle) { bvhDirty = true; structureVersion++; return modelIds[markDirty(indexOf(handle))]; }
+		uint32_t& flags(ObtSceneHandle handle) { uint32_t index = indexOf(handle); markChanged(denseToSlot[index]); return objectFlags[index]; }
+
+		const std::vector<glm::vec3>& getTranslations() const { return translations; }
+		const std::vector<glm::quat>& getRotations() const { return rotations; }
+		const std::vector<glm::vec3>& getScales() const { return scales; }
+		const std::vector<model_id_t>& getModelIds() const { return modelIds; }
+		const std::vector<uint32_t>& getFlags() const { return objectFlags; }
+		const std::vector<uint32_t>& getParents() const { return parents; }
+		const std::vector<ObtWorldTransform>& getWorldTransforms() const { return worldTransforms; }
+		const std::vector<glm::vec4>& getWorldBounds() const { return worldBounds; }
+		const ObtBvh& getBvh() const { return bvh; }
+
+		uint32_t getLevelCount() const { return static_cast<uint32_t>(levelOffsets.size() - 1); }
+		uint32_t getLevelBegin(uint32_t level) const { return levelOffsets[level]; }
+		uint32_t getLevelEnd(uint32_t level) const { return levelOffsets[level + 1]; }
+
+		void updateTransforms(ObtJobSystem* jobSystem = nullptr);
+		void collectChanges(std::vector<uint32_t>& indices);
+		bool hasChanges() const { return !changedSlots.empty(); }
+
+		// Changes whenever objects are added or removed or an object's model may have changed
+		uint32_t getStructureVersion() const { return structureVersion; }
+
+	private:
+		struct Slot {
+			uint32_t dense = ObtSceneHandle::INVALID_INDEX;
+			uint32_t generation = 0;
+			uint32_t pendingUploads = 0;
+			bool queued = false;
+		};
+
+		uint32_t markDirty(uint32_t index);
+		void markChanged(uint32_t slot);
+		void rebuildOrder();
+		void rebuildLevels();
+		void updateLevel(uint32_t begin, uint32_t end);
+		void updateBounds(uint32_t index);
+		void updateBvh(bool boundsChanged, ObtJobSystem* jobSystem);
+
+		template<typename T>
+		static void permute(std::vector<T>& values, const std::vector<uint32_t>& order);
+
+		std::vector<glm::vec3> translations;
+		std::vector<glm::quat> rotations;
+		std::vector<glm::vec3> scales;
+		std::vector<model_id_t> modelIds;
+		std::vector<uint32_t> objectFlags;
+		std::vector<uint32_t> parents;
+		std::vector<uint32_t> depths;
+		std::vector<uint8_t> transformDirty;
+		std::vector<ObtWorldTransform> worldTransforms;
+		std::vector<glm::vec4> worldBounds;
+		std::vector<uint32_t> denseToSlot;
+
+		std::vector<uint32_t> levelOffsets{0};
+		bool orderDirty = false;
+		bool transformsDirty = false;
+
+		ObtBvh bvh;
+		bool bvhDirty = false;
+		uint32_t structureVersion = 0;
+
+		std::vector<Slot> slots;
+		std::vector<uint32_t> freeSlots;
+		std::vector<uint32_t> changedSlots;
+		uint32_t framesInFlight;
+
+		std::vector<std::shared_ptr<ObtModel>> models;
+};
+
+}
@@ -0,0 +1,97 @@
+#include "obt_stream_copy.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define OBT_STREAM_COPY_X86
+#include <immintrin.h>
+#endif
+
+namespace obt {
+
+// Below this the fence and alignment handling cost more than the cache pollution saves
+static constexpr size_t STREAM_COPY_THRESHOLD = 256;
+
+#ifdef OBT_STREAM_COPY_X86
+
+__attribute__((target("sse2")))
+static void streamCopySse2(char* dst, const char* src, size_t size) {
+	for (; size >= 64; size -= 64, src += 64, dst += 64) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+		__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 48));
+		_mm_stream_si128(reinterpret_cast<__m128i*>(dst), a);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(dst + 16), b);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(dst + 32), c);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(dst + 48), d);
+	}
+	for (; size >= 16; size -= 16, src += 16, dst += 16) {
+		_mm_stream_si128(reinterpret_cast<__m128i*>(dst), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+	}
+	_mm_sfence();
+	std::memcpy(dst, src, size);
+}
+
+__attribute__((target("avx")))
+static void streamCopyAvx(char* dst, const char* src, size_t size) {
+	for (; size >= 128; size -= 128, src += 128, dst += 128) {
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 32));
+		__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 64));
+		__m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 96));
+		_mm256_stream_si256(reinterpret_cast<__m256i*>(dst), a);
+		_mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 32), b);
+		_mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 64), c);
+		_mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 96), d);
+	}
+	for (; size >= 32; size -= 32, src += 32, dst += 32) {
+		_mm256_stream_si256(reinterpret_cast<__m256i*>(dst), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)));
+	}
+	_mm_sfence();
+	std::memcpy(dst, src, size);
+}
+
+using StreamCopyFn = void (*)(char*, const char*, size_t);
+
+static StreamCopyFn selectStreamCopy(size_t& alignment) {
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx")) {
+		alignment = 32;
+		return streamCopyAvx;
+	}
+	alignment = 16;
+	return streamCopySse2;
+}
+
+#endif
+
+/**
+ * Copies size bytes from src to dst using non-temporal stores, the implementation is picked once
+ * at runtime based on the cpu
+ *
+ * @note The copy is fenced, so the data is globally visible before a later flush or submit
+ */
+void streamCopy(void* dst, const void* src, size_t size) {
+#ifdef OBT_STREAM_COPY_X86
+	static size_t alignment = 0;
+	static const StreamCopyFn copy = selectStreamCopy(alignment);
+
+	if (size < STREAM_COPY_THRESHOLD) {
+		std::memcpy(dst, src, size);
+		return;
+	}
+
+	// Stream stores need an aligned destination, the unaligned head goes through memcpy
+	char* d = static_cast<char*>(dst);
+	const char* s = static_cast<const char*>(src);
+	size_t head = (alignment - (reinterpret_cast<uintptr_t>(d) & (alignment - 1))) & (alignment - 1);
+	std::memcpy(d, s, head);
+	copy(d + head, s + head, size - head);
+#else
+	std::memcpy(dst, src, size);
+#endif
+}
+
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+
+namespace obt {
+
+// Copies with non-temporal stores that bypass the cache, meant for write-combined mapped memory
+// which is written once per frame and never read back by the CPU. Falls back to memcpy for small
+// copies and on targets without SSE2.
+void streamCopy(void* dst, const void* src, size_t size);
+
+}
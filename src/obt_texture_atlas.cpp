@@ -0,0 +1,543 @@
+#include "obt_texture_atlas.hpp"
+
+#include "obt_job_system.hpp"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace obt {
+
+namespace {
+
+constexpr uint32_t COOKED_MAGIC = 0x4154424f; // "OBTA"
+constexpr uint32_t COOKED_VERSION = 1;
+
+struct PackRect {
+	uint32_t x, y, width, height;
+};
+
+class RectPacker {
+	public:
+		RectPacker(uint32_t width, uint32_t height) : width{width}, height{height} {}
+		virtual ~RectPacker() = default;
+
+		virtual bool insert(uint32_t rectWidth, uint32_t rectHeight, uint32_t& outX, uint32_t& outY) = 0;
+
+	protected:
+		uint32_t width;
+		uint32_t height;
+};
+
+// Bottom-left skyline packer, picks the position that keeps the skyline lowest
+class SkylinePacker : public RectPacker {
+	public:
+		SkylinePacker(uint32_t width, uint32_t height) : RectPacker{width, height} {
+			skyline.push_back({0, 0, width});
+		}
+
+		bool insert(uint32_t rectWidth, uint32_t rectHeight, uint32_t& outX, uint32_t& outY) override {
+			uint32_t bestTop = std::numeric_limits<uint32_t>::max();
+			uint32_t bestWidth = std::numeric_limits<uint32_t>::max();
+			size_t bestIndex = skyline.size();
+
+			for (size_t i = 0; i < skyline.size(); ++i) {
+				uint32_t y;
+				if (!fits(i, rectWidth, rectHeight, y)) continue;
+
+				uint32_t top = y + rectHeight;
+				if (top < bestTop || (top == bestTop && skyline[i].width < bestWidth)) {
+					bestTop = top;
+					bestWidth = skyline[i].width;
+					bestIndex = i;
+					outX = skyline[i].x;
+					outY = y;
+				}
+			}
+
+			if (bestIndex == skyline.size()) return false;
+
+			addLevel(bestIndex, outX, outY + rectHeight, rectWidth);
+			return true;
+		}
+
+	private:
+		struct Node {
+			uint32_t x, y, width;
+		};
+
+		bool fits(size_t index, uint32_t rectWidth, uint32_t rectHeight, uint32_t& outY) const {
+			if (skyline[index].x + rectWidth > width) return false;
+
+			uint32_t y = skyline[index].y;
+			int64_t widthLeft = rectWidth;
+			for (size_t i = index; widthLeft > 0; ++i) {
+				y = std::max(y, skyline[i].y);
+				if (y + rectHeight > height) return false;
+				widthLeft -= skyline[i].width;
+			}
+
+			outY = y;
+			return true;
+		}
+
+		void addLevel(size_t index, uint32_t x, uint32_t y, uint32_t levelWidth) {
+			skyline.insert(skyline.begin() + index, Node{x, y, levelWidth});
+
+			for (size_t i = index + 1; i < skyline.size(); ++i) {
+				uint32_t previousEnd = skyline[i - 1].x + skyline[i - 1].width;
+				if (skyline[i].x >= previousEnd) break;
+
+				uint32_t shrink = previousEnd - skyline[i].x;
+				if (skyline[i].width <= shrink) {
+					skyline.erase(skyline.begin() + i);
+					--i;
+				} else {
+					skyline[i].x += shrink;
+					skyline[i].width -= shrink;
+					break;
+				}
+			}
+
+			for (size_t i = 0; i + 1 < skyline.size(); ++i) {
+				if (skyline[i].y == skyline[i + 1].y) {
+					skyline[i].width += skyline[i + 1].width;
+					skyline.erase(skyline.begin() + i + 1);
+					--i;
+				}
+			}
+		}
+
+		std::vector<Node> skyline;
+};
+
+// Guillotine packer using best short side fit and a shorter axis split
+class GuillotinePacker : public RectPacker {
+	public:
+		GuillotinePacker(uint32_t width, uint32_t height) : RectPacker{width, height} {
+			freeRects.push_back({0, 0, width, height});
+		}
+
+		bool insert(uint32_t rectWidth, uint32_t rectHeight, uint32_t& outX, uint32_t& outY) override {
+			uint32_t bestShortSide = std::numeric_limits<uint32_t>::max();
+			size_t bestIndex = freeRects.size();
+
+			for (size_t i = 0; i < freeRects.size(); ++i) {
+				const auto& rect = freeRects[i];
+				if (rectWidth > rect.width || rectHeight > rect.height) continue;
+
+				uint32_t shortSide = std::min(rect.width - rectWidth, rect.height - rectHeight);
+				if (shortSide < bestShortSide) {
+					bestShortSide = shortSide;
+					bestIndex = i;
+				}
+			}
+
+			if (bestIndex == freeRects.size()) return false;
+
+			PackRect rect = freeRects[bestIndex];
+			freeRects.erase(freeRects.begin() + bestIndex);
+			outX = rect.x;
+			outY = rect.y;
+
+			uint32_t leftoverWidth = rect.width - rectWidth;
+			uint32_t leftoverHeight = rect.height - rectHeight;
+
+			PackRect right, bottom;
+			if (leftoverWidth < leftoverHeight) {
+				right = {rect.x + rectWidth, rect.y, leftoverWidth, rectHeight};
+				bottom = {rect.x, rect.y + rectHeight, rect.width, leftoverHeight};
+			} else {
+				right = {rect.x + rectWidth, rect.y, leftoverWidth, rect.height};
+				bottom = {rect.x, rect.y + rectHeight, rectWidth, leftoverHeight};
+			}
+
+			if (right.width > 0 && right.height > 0) freeRects.push_back(right);
+			if (bottom.width > 0 && bottom.height > 0) freeRects.push_back(bottom);
+			return true;
+		}
+
+	private:
+		std::vector<PackRect> freeRects;
+};
+
+uint32_t alignUp(uint32_t value, uint32_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+template <typename T>
+void writeValue(std::ofstream& file, const T& value) {
+	file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void readValue(std::ifstream& file, T& value) {
+	file.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+}
+
+void ObtTextureAtlas::Builder::loadTextures(const std::vector<std::string>& filePaths, ObtJobSystem* jobSystem) {
+	struct Source {
+		int width, height;
+		stbi_uc* pixels;
+	};
+
+	// Files are decoded independently, so with a job system every file is its own job
+	std::vector<Source> sources(filePaths.size());
+	auto decode = [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			int channels;
+			sources[i].pixels = stbi_load(filePaths[i].c_str(), &sources[i].width, &sources[i].height, &channels, STBI_rgb_alpha);
+		}
+	};
+	if (jobSystem != nullptr) {
+		jobSystem->parallelFor(static_cast<uint32_t>(filePaths.size()), 1, decode);
+	} else {
+		decode(0, static_cast<uint32_t>(filePaths.size()));
+	}
+
+	for (size_t i = 0; i < sources.size(); ++i) {
+		if (!sources[i].pixels) {
+			for (auto& source : sources) stbi_image_free(source.pixels);
+			throw std::runtime_error("Failed to load texture file: " + filePaths[i]);
+		}
+	}
+
+	// Each extra mip level halves the padding, and rects are aligned so that texels of
+	// neighbouring regions never share a texel of a lower level
+	mipLevels = 1;
+	while ((2u << (mipLevels - 1)) <= padding) ++mipLevels;
+	uint32_t alignment = 1u << (mipLevels - 1);
+
+	std::vector<PackRect> rects(sources.size());
+	for (size_t i = 0; i < sources.size(); ++i) {
+		rects[i].width = alignUp(static_cast<uint32_t>(sources[i].width) + 2*padding, alignment);
+		rects[i].height = alignUp(static_cast<uint32_t>(sources[i].height) + 2*padding, alignment);
+	}
+
+	regions.assign(sources.size(), Region{});
+
+	if (layout == Layout::Array) {
+		width = 0;
+		height = 0;
+		for (size_t i = 0; i < rects.size(); ++i) {
+			width = std::max(width, rects[i].width);
+			height = std::max(height, rects[i].height);
+			rects[i].x = 0;
+			rects[i].y = 0;
+			regions[i].layer = static_cast<uint32_t>(i);
+		}
+		layerCount = static_cast<uint32_t>(rects.size());
+	} else {
+		width = pageSize;
+		height = pageSize;
+
+		std::vector<size_t> order(rects.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return rects[a].height > rects[b].height; });
+
+		std::vector<std::unique_ptr<RectPacker>> pages;
+		for (size_t index : order) {
+			auto& rect = rects[index];
+			if (rect.width > pageSize || rect.height > pageSize) {
+				for (auto& source : sources) stbi_image_free(source.pixels);
+				throw std::runtime_error("Texture does not fit in atlas page: " + filePaths[index]);
+			}
+
+			bool placed = false;
+			for (size_t page = 0; page < pages.size() && !placed; ++page) {
+				if (pages[page]->insert(rect.width, rect.height, rect.x, rect.y)) {
+					regions[index].layer = static_cast<uint32_t>(page);
+					placed = true;
+				}
+			}
+
+			if (!placed) {
+				if (layout == Layout::Skyline) {
+					pages.push_back(std::make_unique<SkylinePacker>(pageSize, pageSize));
+				} else {
+					pages.push_back(std::make_unique<GuillotinePacker>(pageSize, pageSize));
+				}
+				pages.back()->insert(rect.width, rect.height, rect.x, rect.y);
+				regions[index].layer = static_cast<uint32_t>(pages.size() - 1);
+			}
+		}
+		layerCount = static_cast<uint32_t>(pages.size());
+	}
+
+	size_t layerSize = static_cast<size_t>(width) * height * 4;
+	pixels.assign(layerSize * layerCount, 0);
+
+	for (size_t i = 0; i < sources.size(); ++i) {
+		const auto& source = sources[i];
+		const auto& rect = rects[i];
+		unsigned char* layerPixels = pixels.data() + layerSize * regions[i].layer;
+
+		// Fill the padded rect by clamping to the source edges so filtering never bleeds
+		for (uint32_t y = 0; y < rect.height; ++y) {
+			int sy = std::clamp(static_cast<int>(y) - static_cast<int>(padding), 0, source.height - 1);
+			for (uint32_t x = 0; x < rect.width; ++x) {
+				int sx = std::clamp(static_cast<int>(x) - static_cast<int>(padding), 0, source.width - 1);
+				const stbi_uc* src = source.pixels + (static_cast<size_t>(sy) * source.width + sx) * 4;
+				unsigned char* dst = layerPixels + (static_cast<size_t>(rect.y + y) * width + rect.x + x) * 4;
+				memcpy(dst, src, 4);
+			}
+		}
+
+		regions[i].uvOffset = glm::vec2{
+			static_cast<float>(rect.x + padding) / width,
+			static_cast<float>(rect.y + padding) / height};
+		regions[i].uvScale = glm::vec2{
+			static_cast<float>(source.width) / width,
+			static_cast<float>(source.height) / height};
+
+		stbi_image_free(source.pixels);
+	}
+}
+
+void ObtTextureAtlas::Builder::saveCooked(const std::string& filePath) const {
+	std::ofstream file{filePath, std::ios::binary};
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open file: " + filePath);
+	}
+
+	writeValue(file, COOKED_MAGIC);
+	writeValue(file, COOKED_VERSION);
+	writeValue(file, static_cast<uint32_t>(layout));
+	writeValue(file, width);
+	writeValue(file, height);
+	writeValue(file, layerCount);
+	writeValue(file, mipLevels);
+	writeValue(file, static_cast<uint32_t>(regions.size()));
+	for (const auto& region : regions) {
+		writeValue(file, region.layer);
+		writeValue(file, region.uvOffset);
+		writeValue(file, region.uvScale);
+	}
+	file.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+}
+
+void ObtTextureAtlas::Builder::loadCooked(const std::string& filePath) {
+	std::ifstream file{filePath, std::ios::binary};
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open file: " + filePath);
+	}
+
+	uint32_t magic, version, layoutValue, regionCount;
+	readValue(file, magic);
+	readValue(file, version);
+	if (magic != COOKED_MAGIC || version != COOKED_VERSION) {
+		throw std::runtime_error("Invalid cooked atlas file: " + filePath);
+	}
+
+	readValue(file, layoutValue);
+	layout = static_cast<Layout>(layoutValue);
+	readValue(file, width);
+	readValue(file, height);
+	readValue(file, layerCount);
+	readValue(file, mipLevels);
+	readValue(file, regionCount);
+
+	regions.resize(regionCount);
+	for (auto& region : regions) {
+		readValue(file, region.layer);
+		readValue(file, region.uvOffset);
+		readValue(file, region.uvScale);
+	}
+
+	pixels.resize(static_cast<size_t>(width) * height * 4 * layerCount);
+	file.read(reinterpret_cast<char*>(pixels.data()), pixels.size());
+	if (!file) {
+		throw std::runtime_error("Truncated cooked atlas file: " + filePath);
+	}
+}
+
+ObtTextureAtlas::ObtTextureAtlas(ObtDevice& obtDevice, const ObtTextureAtlas::Builder& builder, VkFormat imageFormat)
+	: obtDevice{obtDevice}, imageFormat{imageFormat}, width{builder.width}, height{builder.height}, layerCount{builder.layerCount}, mipLevels{builder.mipLevels}, regions{builder.regions} {
+	createImage(builder);
+	createImageView();
+	obtDevice.registerRelocatable(this);
+}
+
+ObtTextureAtlas::~ObtTextureAtlas() {
+	obtDevice.unregisterRelocatable(this);
+	vkDestroyImageView(obtDevice.device(), imageView, nullptr);
+	obtDevice.destroyImage(atlasImage, atlasImageMemory);
+}
+
+std::unique_ptr<ObtTextureAtlas> ObtTextureAtlas::createAtlasFromFiles(ObtDevice& device, const std::vector<std::string>& filePaths, Layout layout, ObtJobSystem* jobSystem) {
+	Builder builder{};
+	builder.layout = layout;
+	builder.loadTextures(filePaths, jobSystem);
+
+	return std::make_unique<ObtTextureAtlas>(device, builder);
+}
+
+std::unique_ptr<ObtTextureAtlas> ObtTextureAtlas::createAtlasFromCookedFile(ObtDevice& device, const std::string& filePath) {
+	Builder builder{};
+	builder.loadCooked(filePath);
+
+	return std::make_unique<ObtTextureAtlas>(device, builder);
+}
+
+void ObtTextureAtlas::cookAtlas(const std::vector<std::string>& filePaths, const std::string& outPath, Layout layout, ObtJobSystem* jobSystem) {
+	Builder builder{};
+	builder.layout = layout;
+	builder.loadTextures(filePaths, jobSystem);
+	builder.saveCooked(outPath);
+}
+
+void ObtTextureAtlas::createImage(const ObtTextureAtlas::Builder& builder) {
+	assert(layerCount > 0 && "Cannot create an atlas without layers!");
+
+	// Mips are generated with linear filtered blits between levels of the image itself
+	VkFormatFeatureFlags mipFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+	if (mipLevels > 1 && !obtDevice.isFormatSupported(imageFormat, VK_IMAGE_TILING_OPTIMAL, mipFeatures)) {
+		mipLevels = 1;
+	}
+
+	VkDeviceSize imageSize = builder.pixels.size();
+	ObtBuffer stagingBuffer{obtDevice, imageSize, 1, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+	stagingBuffer.map();
+	stagingBuffer.writeToBuffer((void*)builder.pixels.data());
+	stagingBuffer.unmap();
+
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent.width = width;
+	imageInfo.extent.height = height;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = mipLevels;
+	imageInfo.arrayLayers = layerCount;
+	imageInfo.format = imageFormat;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.flags = 0;
+
+	obtDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, atlasImage, atlasImageMemory);
+
+	VkCommandBuffer commandBuffer = obtDevice.beginSingleTimeCommands();
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = atlasImage;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = mipLevels;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = layerCount;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	obtDevice.endSingleTimeCommands(commandBuffer);
+
+	obtDevice.copyBufferToImage(stagingBuffer.getBuffer(), atlasImage, width, height, layerCount);
+	generateMipmaps();
+}
+
+void ObtTextureAtlas::generateMipmaps() {
+	VkCommandBuffer commandBuffer = obtDevice.beginSingleTimeCommands();
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = atlasImage;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = layerCount;
+
+	int32_t mipWidth = static_cast<int32_t>(width);
+	int32_t mipHeight = static_cast<int32_t>(height);
+	for (uint32_t i = 1; i < mipLevels; ++i) {
+		barrier.subresourceRange.baseMipLevel = i - 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		int32_t nextWidth = mipWidth > 1 ? mipWidth / 2 : 1;
+		int32_t nextHeight = mipHeight > 1 ? mipHeight / 2 : 1;
+
+		VkImageBlit blit{};
+		blit.srcOffsets[0] = {0, 0, 0};
+		blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = i - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = layerCount;
+		blit.dstOffsets[0] = {0, 0, 0};
+		blit.dstOffsets[1] = {nextWidth, nextHeight, 1};
+		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.mipLevel = i;
+		blit.dstSubresource.baseArrayLayer = 0;
+		blit.dstSubresource.layerCount = layerCount;
+		vkCmdBlitImage(commandBuffer, atlasImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, atlasImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		mipWidth = nextWidth;
+		mipHeight = nextHeight;
+	}
+
+	barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	obtDevice.endSingleTimeCommands(commandBuffer);
+}
+
+void ObtTextureAtlas::createImageView() {
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = atlasImage;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+	viewInfo.format = imageFormat;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.baseMipLevel = 0;
+	viewInfo.subresourceRange.levelCount = mipLevels;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount = layerCount;
+
+	if (vkCreateImageView(obtDevice.device(), &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create atlas image view!");
+	}
+}
+
+void ObtTextureAtlas::relocate(VkCommandBuffer commandBuffer, ObtRetiredResource& retired) {
+	retired.imageView = imageView;
+	obtDevice.relocateImage(commandBuffer, imageInfo, atlasImage, atlasImageMemory, retired);
+	createImageView();
+	generation++;
+}
+
+VkDescriptorImageInfo ObtTextureAtlas::descriptorInfo(VkSampler sampler) {
+	return VkDescriptorImageInfo{sampler, imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+}
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "obt_device.hpp"
+#include "obt_buffer.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace obt {
+
+class ObtJobSystem;
+
+class ObtTextureAtlas : public ObtRelocatable {
+	public:
+		enum class Layout : uint32_t {
+			Array,
+			Skyline,
+			Guillotine
+		};
+
+		struct Region {
+			uint32_t layer;
+			glm::vec2 uvOffset;
+			glm::vec2 uvScale;
+		};
+
+		struct Builder {
+			Layout layout = Layout::Skyline;
+			uint32_t pageSize = 2048;
+			uint32_t padding = 4;
+
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t layerCount = 0;
+			uint32_t mipLevels = 1;
+			std::vector<Region> regions{};
+			std::vector<unsigned char> pixels{};
+
+			void loadTextures(const std::vector<std::string>& filePaths, ObtJobSystem* jobSystem = nullptr);
+			void saveCooked(const std::string& filePath) const;
+			void loadCooked(const std::string& filePath);
+		};
+
+		ObtTextureAtlas(ObtDevice& obtDevice, const ObtTextureAtlas::Builder& builder, VkFormat imageFormat = VK_FORMAT_R8G8B8A8_SRGB);
+		~ObtTextureAtlas();
+
+		ObtTextureAtlas(const ObtTextureAtlas&) = delete;
+		ObtTextureAtlas &operator=(const ObtTextureAtlas&) = delete;
+
+		static std::unique_ptr<ObtTextureAtlas> createAtlasFromFiles(ObtDevice& device, const std::vector<std::string>& filePaths, Layout layout = Layout::Skyline, ObtJobSystem* jobSystem = nullptr);
+		static std::unique_ptr<ObtTextureAtlas> createAtlasFromCookedFile(ObtDevice& device, const std::string& filePath);
+		static void cookAtlas(const std::vector<std::string>& filePaths, const std::string& outPath, Layout layout = Layout::Skyline, ObtJobSystem* jobSystem = nullptr);
+
+		const Region& getRegion(uint32_t index) const { return regions[index]; }
+		uint32_t getRegionCount() const { return static_cast<uint32_t>(regions.size()); }
+		uint32_t getLayerCount() const { return layerCount; }
+
+		VkDescriptorImageInfo descriptorInfo(VkSampler sampler);
+		uint32_t getGeneration() const { return generation; }
+
+		const ObtAllocation& getAllocation() const override { return atlasImageMemory; }
+		void relocate(VkCommandBuffer commandBuffer, ObtRetiredResource& retired) override;
+
+	private:
+		void createImage(const ObtTextureAtlas::Builder& builder);
+		void generateMipmaps();
+		void createImageView();
+
+		ObtDevice& obtDevice;
+
+		VkImage atlasImage;
+		ObtAllocation atlasImageMemory;
+		VkImageCreateInfo imageInfo{};
+		VkImageView imageView;
+		VkFormat imageFormat;
+
+		uint32_t width;
+		uint32_t height;
+		uint32_t layerCount;
+		uint32_t mipLevels;
+		std::vector<Region> regions;
+		uint32_t generation = 0;
+};
+
+}
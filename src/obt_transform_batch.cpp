@@ -0,0 +1,240 @@
+#include "obt_transform_batch.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define OBT_TRANSFORM_BATCH_X86
+#include <immintrin.h>
+#endif
+
+namespace obt {
+
+static glm::mat4* advance(glm::mat4* matrix, size_t bytes) {
+	return reinterpret_cast<glm::mat4*>(reinterpret_cast<char*>(matrix) + bytes);
+}
+
+static void computeTransformScalar(const glm::vec3& t, const glm::quat& q, const glm::vec3& s, glm::mat4& model, glm::mat4& normal) {
+	float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+	glm::vec3 r0{1.f - 2.f * (yy + zz), 2.f * (xy + wz), 2.f * (xz - wy)};
+	glm::vec3 r1{2.f * (xy - wz), 1.f - 2.f * (xx + zz), 2.f * (yz + wx)};
+	glm::vec3 r2{2.f * (xz + wy), 2.f * (yz - wx), 1.f - 2.f * (xx + yy)};
+
+	model[0] = glm::vec4{r0 * s.x, 0.f};
+	model[1] = glm::vec4{r1 * s.y, 0.f};
+	model[2] = glm::vec4{r2 * s.z, 0.f};
+	model[3] = glm::vec4{t, 1.f};
+
+	// The rotation is orthonormal, so the inverse transpose of R * S is R * S^-1
+	normal[0] = glm::vec4{r0 / s.x, 0.f};
+	normal[1] = glm::vec4{r1 / s.y, 0.f};
+	normal[2] = glm::vec4{r2 / s.z, 0.f};
+	normal[3] = glm::vec4{0.f, 0.f, 0.f, 1.f};
+}
+
+#ifdef OBT_TRANSFORM_BATCH_X86
+
+__attribute__((target("sse2")))
+static inline void storeColumn(glm::mat4* matrix, int column, __m128 value, bool streaming) {
+	float* dst = &(*matrix)[column][0];
+	if (streaming) {
+		_mm_stream_ps(dst, value);
+	} else {
+		_mm_storeu_ps(dst, value);
+	}
+}
+
+// Inputs hold one component per object across the lanes, every step below is the scalar path
+// evaluated for 4 objects at once
+__attribute__((target("sse2")))
+static void computeTransformsSse2(const glm::vec3* t, const glm::quat* q, const glm::vec3* s, uint32_t count,
+	glm::mat4* model, glm::mat4* normal, size_t stride, bool streaming) {
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 two = _mm_set1_ps(2.f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 lastColumn = _mm_setr_ps(0.f, 0.f, 0.f, 1.f);
+
+	for (uint32_t i = 0; i + 4 <= count; i += 4) {
+		__m128 tx = _mm_setr_ps(t[i].x, t[i + 1].x, t[i + 2].x, t[i + 3].x);
+		__m128 ty = _mm_setr_ps(t[i].y, t[i + 1].y, t[i + 2].y, t[i + 3].y);
+		__m128 tz = _mm_setr_ps(t[i].z, t[i + 1].z, t[i + 2].z, t[i + 3].z);
+		__m128 sx = _mm_setr_ps(s[i].x, s[i + 1].x, s[i + 2].x, s[i + 3].x);
+		__m128 sy = _mm_setr_ps(s[i].y, s[i + 1].y, s[i + 2].y, s[i + 3].y);
+		__m128 sz = _mm_setr_ps(s[i].z, s[i + 1].z, s[i + 2].z, s[i + 3].z);
+		__m128 qx = _mm_setr_ps(q[i].x, q[i + 1].x, q[i + 2].x, q[i + 3].x);
+		__m128 qy = _mm_setr_ps(q[i].y, q[i + 1].y, q[i + 2].y, q[i + 3].y);
+		__m128 qz = _mm_setr_ps(q[i].z, q[i + 1].z, q[i + 2].z, q[i + 3].z);
+		__m128 qw = _mm_setr_ps(q[i].w, q[i + 1].w, q[i + 2].w, q[i + 3].w);
+
+		__m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+		__m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+		__m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+
+		__m128 r[3][3] = {
+			{_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), _mm_mul_ps(two, _mm_add_ps(xy, wz)), _mm_mul_ps(two, _mm_sub_ps(xz, wy))},
+			{_mm_mul_ps(two, _mm_sub_ps(xy, wz)), _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), _mm_mul_ps(two, _mm_add_ps(yz, wx))},
+			{_mm_mul_ps(two, _mm_add_ps(xz, wy)), _mm_mul_ps(two, _mm_sub_ps(yz, wx)), _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)))}
+		};
+		__m128 scale[3] = {sx, sy, sz};
+
+		glm::mat4* m[4];
+		glm::mat4* n[4];
+		for (int k = 0; k < 4; k++) {
+			m[k] = model;
+			n[k] = normal;
+			model = advance(model, stride);
+			normal = advance(normal, stride);
+		}
+
+		for (int c = 0; c < 3; c++) {
+			__m128 mx = _mm_mul_ps(r[c][0], scale[c]), my = _mm_mul_ps(r[c][1], scale[c]), mz = _mm_mul_ps(r[c][2], scale[c]), mw = zero;
+			_MM_TRANSPOSE4_PS(mx, my, mz, mw);
+			storeColumn(m[0], c, mx, streaming);
+			storeColumn(m[1], c, my, streaming);
+			storeColumn(m[2], c, mz, streaming);
+			storeColumn(m[3], c, mw, streaming);
+
+			__m128 nx = _mm_div_ps(r[c][0], scale[c]), ny = _mm_div_ps(r[c][1], scale[c]), nz = _mm_div_ps(r[c][2], scale[c]), nw = zero;
+			_MM_TRANSPOSE4_PS(nx, ny, nz, nw);
+			storeColumn(n[0], c, nx, streaming);
+			storeColumn(n[1], c, ny, streaming);
+			storeColumn(n[2], c, nz, streaming);
+			storeColumn(n[3], c, nw, streaming);
+		}
+
+		__m128 tw = one;
+		_MM_TRANSPOSE4_PS(tx, ty, tz, tw);
+		storeColumn(m[0], 3, tx, streaming);
+		storeColumn(m[1], 3, ty, streaming);
+		storeColumn(m[2], 3, tz, streaming);
+		storeColumn(m[3], 3, tw, streaming);
+		for (int k = 0; k < 4; k++) {
+			storeColumn(n[k], 3, lastColumn, streaming);
+		}
+	}
+}
+
+// Transposes 8 lanes of 4 components into one column per object, objects k and k + 4 share a
+// register with k in the low and k + 4 in the high half
+__attribute__((target("avx")))
+static inline void storeColumnsAvx(glm::mat4* const* matrices, int column, __m256 x, __m256 y, __m256 z, __m256 w, bool streaming) {
+	__m256 t0 = _mm256_unpacklo_ps(x, y);
+	__m256 t1 = _mm256_unpackhi_ps(x, y);
+	__m256 t2 = _mm256_unpacklo_ps(z, w);
+	__m256 t3 = _mm256_unpackhi_ps(z, w);
+	__m256 c[4] = {
+		_mm256_shuffle_ps(t0, t2, 0x44),
+		_mm256_shuffle_ps(t0, t2, 0xEE),
+		_mm256_shuffle_ps(t1, t3, 0x44),
+		_mm256_shuffle_ps(t1, t3, 0xEE)
+	};
+	for (int k = 0; k < 4; k++) {
+		storeColumn(matrices[k], column, _mm256_castps256_ps128(c[k]), streaming);
+		storeColumn(matrices[k + 4], column, _mm256_extractf128_ps(c[k], 1), streaming);
+	}
+}
+
+__attribute__((target("avx")))
+static void computeTransformsAvx(const glm::vec3* t, const glm::quat* q, const glm::vec3* s, uint32_t count,
+	glm::mat4* model, glm::mat4* normal, size_t stride, bool streaming) {
+	const __m256 one = _mm256_set1_ps(1.f);
+	const __m256 two = _mm256_set1_ps(2.f);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m128 lastColumn = _mm_setr_ps(0.f, 0.f, 0.f, 1.f);
+
+#define OBT_GATHER8(a, c) _mm256_setr_ps(a[i].c, a[i + 1].c, a[i + 2].c, a[i + 3].c, a[i + 4].c, a[i + 5].c, a[i + 6].c, a[i + 7].c)
+	for (uint32_t i = 0; i + 8 <= count; i += 8) {
+		__m256 tx = OBT_GATHER8(t, x), ty = OBT_GATHER8(t, y), tz = OBT_GATHER8(t, z);
+		__m256 sx = OBT_GATHER8(s, x), sy = OBT_GATHER8(s, y), sz = OBT_GATHER8(s, z);
+		__m256 qx = OBT_GATHER8(q, x), qy = OBT_GATHER8(q, y), qz = OBT_GATHER8(q, z), qw = OBT_GATHER8(q, w);
+
+		__m256 xx = _mm256_mul_ps(qx, qx), yy = _mm256_mul_ps(qy, qy), zz = _mm256_mul_ps(qz, qz);
+		__m256 xy = _mm256_mul_ps(qx, qy), xz = _mm256_mul_ps(qx, qz), yz = _mm256_mul_ps(qy, qz);
+		__m256 wx = _mm256_mul_ps(qw, qx), wy = _mm256_mul_ps(qw, qy), wz = _mm256_mul_ps(qw, qz);
+
+		__m256 r[3][3] = {
+			{_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))), _mm256_mul_ps(two, _mm256_add_ps(xy, wz)), _mm256_mul_ps(two, _mm256_sub_ps(xz, wy))},
+			{_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))), _mm256_mul_ps(two, _mm256_add_ps(yz, wx))},
+			{_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), _mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy)))}
+		};
+		__m256 scale[3] = {sx, sy, sz};
+
+		glm::mat4* m[8];
+		glm::mat4* n[8];
+		for (int k = 0; k < 8; k++) {
+			m[k] = model;
+			n[k] = normal;
+			model = advance(model, stride);
+			normal = advance(normal, stride);
+		}
+
+		for (int c = 0; c < 3; c++) {
+			storeColumnsAvx(m, c, _mm256_mul_ps(r[c][0], scale[c]), _mm256_mul_ps(r[c][1], scale[c]), _mm256_mul_ps(r[c][2], scale[c]), zero, streaming);
+			storeColumnsAvx(n, c, _mm256_div_ps(r[c][0], scale[c]), _mm256_div_ps(r[c][1], scale[c]), _mm256_div_ps(r[c][2], scale[c]), zero, streaming);
+		}
+		storeColumnsAvx(m, 3, tx, ty, tz, one, streaming);
+		for (int k = 0; k < 8; k++) {
+			storeColumn(n[k], 3, lastColumn, streaming);
+		}
+	}
+#undef OBT_GATHER8
+}
+
+using ComputeTransformsFn = void (*)(const glm::vec3*, const glm::quat*, const glm::vec3*, uint32_t, glm::mat4*, glm::mat4*, size_t, bool);
+
+static ComputeTransformsFn selectComputeTransforms(uint32_t& width) {
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx")) {
+		width = 8;
+		return computeTransformsAvx;
+	}
+	width = 4;
+	return computeTransformsSse2;
+}
+
+#endif
+
+/**
+ * Computes model and normal matrices for count objects, equivalent to TransformComponent::mat4()
+ * and normalMatrix() but processing 4 or 8 objects per iteration depending on the cpu
+ *
+ * @note With streaming set the matrices are written with non-temporal stores, meant for write
+ * combined mapped memory. Streaming is ignored unless both destinations and the stride are 16 byte
+ * aligned.
+ *
+ * @param translations, rotations, scales Transform components of each object
+ * @param count Number of objects
+ * @param modelMatrices Destination of the first model matrix
+ * @param normalMatrices Destination of the first normal matrix
+ * @param stride Distance in bytes between the matrices of consecutive objects
+ * @param streaming Whether to bypass the cache when writing
+ */
+void computeTransformMatrices(const glm::vec3* translations, const glm::quat* rotations, const glm::vec3* scales, uint32_t count,
+	glm::mat4* modelMatrices, glm::mat4* normalMatrices, size_t stride, bool streaming) {
+	uint32_t done = 0;
+
+#ifdef OBT_TRANSFORM_BATCH_X86
+	static uint32_t width = 0;
+	static const ComputeTransformsFn compute = selectComputeTransforms(width);
+
+	streaming = streaming && ((reinterpret_cast<uintptr_t>(modelMatrices) | reinterpret_cast<uintptr_t>(normalMatrices) | stride) & 15) == 0;
+
+	done = count / width * width;
+	if (done > 0) {
+		compute(translations, rotations, scales, done, modelMatrices, normalMatrices, stride, streaming);
+		modelMatrices = advance(modelMatrices, stride * done);
+		normalMatrices = advance(normalMatrices, stride * done);
+	}
+	if (streaming) {
+		_mm_sfence();
+	}
+#endif
+
+	for (uint32_t i = done; i < count; i++) {
+		computeTransformScalar(translations[i], rotations[i], scales[i], *modelMatrices, *normalMatrices);
+		modelMatrices = advance(modelMatrices, stride);
+		normalMatrices = advance(normalMatrices, stride);
+	}
+}
+
+}
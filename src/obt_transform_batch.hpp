@@ -0,0 +1,19 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace obt {
+
+// Builds translate * rotate * scale model matrices and their inverse transpose normal matrices
+// for a whole array of objects at once, several objects per SIMD register. The results are
+// written with a byte stride so they can land directly in an interleaved, mapped storage buffer.
+void computeTransformMatrices(const glm::vec3* translations, const glm::quat* rotations, const glm::vec3* scales, uint32_t count,
+	glm::mat4* modelMatrices, glm::mat4* normalMatrices, size_t stride, bool streaming = false);
+
+}
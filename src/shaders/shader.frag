@@ -12,6 +12,7 @@ layout(set = 0, binding = 1) uniform SceneUbo {
 	float ambient;
 	vec3 lightPos;
 	vec3 camPos;
+	int lightCount;
 } scene;
 
 struct LightData {
@@ -55,7 +56,7 @@ void main() {
 	LightData dirLight = {scene.lightPos, vec4(1.0)};
 	vec3 result = dirLightColor(dirLight, fragNormal, lightDir, viewDir);
 
-	for (int i = 0; i < 3; ++i) {
+	for (int i = 0; i < scene.lightCount; ++i) {
 		result += pointLightColor(lightSbo.lights[i], fragNormal, viewDir);
 	}
 
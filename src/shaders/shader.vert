@@ -24,9 +24,16 @@ layout(std140, set = 1, binding = 0) readonly buffer ObjectSbo {
 	ObjectData objects[];
 } objectSbo;
 
+// Object indices of every drawn instance, instances of one draw are contiguous
+layout(std430, set = 1, binding = 1) readonly buffer InstanceSbo {
+	uint objectIndices[];
+} instanceSbo;
+
 void main() {
-	mat4 modelMatrix = objectSbo.objects[gl_BaseInstance].modelMatrix;
-	mat4 normalMatrix = objectSbo.objects[gl_BaseInstance].normalMatrix;
+	// gl_InstanceIndex already starts at the draw's first instance
+	uint objectIndex = instanceSbo.objectIndices[gl_InstanceIndex];
+	mat4 modelMatrix = objectSbo.objects[objectIndex].modelMatrix;
+	mat4 normalMatrix = objectSbo.objects[objectIndex].normalMatrix;
 
 	vec4 p = modelMatrix * vec4(position, 1.0);
 	gl_Position = camera.projView * p;
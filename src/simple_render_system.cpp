@@ -5,14 +5,22 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <algorithm>
 #include <stdexcept>
 #include <array>
 
 namespace obt {
 
-SimpleRenderSystem::SimpleRenderSystem(ObtDevice& device, VkRenderPass renderPass, std::vector<VkDescriptorSetLayout>& descriptorSetLayouts) : obtDevice{device} {
+SimpleRenderSystem::SimpleRenderSystem(ObtDevice& device, VkRenderPass renderPass, std::vector<VkDescriptorSetLayout>& descriptorSetLayouts, uint32_t framesInFlight) : obtDevice{device} {
 	createPipelineLayout(descriptorSetLayouts);
 	createPipeline(renderPass);
+
+	if (obtDevice.isMultiDrawIndirectSupported()) {
+		indirectBuffers.resize(framesInFlight);
+		for (auto& indirectBuffer : indirectBuffers) {
+			indirectBuffer = std::make_unique<ObtGrowableBuffer>(obtDevice, sizeof(VkDrawIndexedIndirectCommand), 64, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+		}
+	}
 }
 
 SimpleRenderSystem::~SimpleRenderSystem() {
@@ -42,18 +50,188 @@ void SimpleRenderSystem::createPipeline(VkRenderPass renderPass) {
 	obtPipeline = std::make_unique<ObtPipeline>(obtDevice, "res/shaders/shader.vert.spv", "res/shaders/shader.frag.spv", pipelineConfig);
 }
 
-void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo, std::vector<ObtGameObject>& gameObjects) {
-	obtPipeline->bind(frameInfo.commandBuffer);
+/**
+ * Builds a draw key for every visible object and radix sorts them. Runs of keys that only differ in
+ * their depth bucket become one instanced batch, so batches come out ordered by pass, pipeline,
+ * material and model, and the instances of a batch front to back.
+ *
+ * @param visibleObjects Culled objects, hidden objects and objects without a model already dropped
+ * @param instances Filled with the object index of every instance
+ * @param batches Filled with one batch per run of keys drawn with the same state
+ */
+void SimpleRenderSystem::sortDraws(const ObtScene& scene, const ObtCamera& camera, const std::vector<uint32_t>& visibleObjects, std::vector<uint32_t>& instances, std::vector<InstanceBatch>& batches) {
+	auto& modelIds = scene.getModelIds();
+	auto& bounds = scene.getWorldBounds();
+	const glm::mat4& view = camera.getView();
+	float maxDepth = camera.getFar();
+
+	drawItems.resize(visibleObjects.size());
+	for (size_t i = 0; i < visibleObjects.size(); i++) {
+		uint32_t object = visibleObjects[i];
+		const glm::vec4& sphere = bounds[object];
+		// View space depth of the nearest point of the bounding sphere
+		float depth = view[0][2] * sphere.x + view[1][2] * sphere.y + view[2][2] * sphere.z + view[3][2] - sphere.w;
+		uint64_t key = makeDrawKey(PASS_OPAQUE, PIPELINE_DEFAULT, MATERIAL_DEFAULT, modelIds[object], depthToBucket(depth, maxDepth));
+		drawItems[i] = ObtDrawItem{key, object};
+	}
+	radixSortDrawItems(drawItems, drawItemScratch);
+
+	batches.clear();
+	instances.resize(drawItems.size());
+	for (uint32_t i = 0; i < static_cast<uint32_t>(drawItems.size()); i++) {
+		instances[i] = drawItems[i].objectIndex;
+		uint64_t state = drawItems[i].key & DRAW_KEY_STATE_MASK;
+		if (batches.empty() || batches.back().key != state) {
+			batches.push_back(InstanceBatch{state, i, 0});
+		}
+		batches.back().instanceCount++;
+	}
+}
+
+/**
+ * Draws sorted batches, with one indirect draw per run of pooled models when the device supports
+ * multi draw indirect and one draw call per batch otherwise
+ *
+ * @note With a renderer and a job system the batches are recorded in parallel into secondary
+ * command buffers, the render pass must then have been begun with secondary command buffer contents.
+ * If the renderer caches commands they are only recorded again once the batches or the frame's
+ * resources changed.
+ */
+void SimpleRenderSystem::renderScene(FrameInfo& frameInfo, ObtScene& scene, const std::vector<InstanceBatch>& batches, ObtRenderer* renderer, ObtJobSystem* jobSystem) {
+	uint32_t batchCount = static_cast<uint32_t>(batches.size());
+	bool multiDraw = !indirectBuffers.empty();
+	if (multiDraw) {
+		indirectBuffers[frameInfo.frameIndex]->reserve(batchCount);
+	}
+
+	auto record = [&](VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end) {
+		if (multiDraw) {
+			recordMultiDraw(commandBuffer, frameInfo, scene, batches, begin, end);
+		} else {
+			recordDirect(commandBuffer, frameInfo, scene, batches, begin, end);
+		}
+	};
+
+	if (renderer != nullptr && jobSystem != nullptr) {
+		uint32_t threadCount = jobSystem->getThreadCount();
+		uint32_t grainSize = std::max((batchCount + threadCount - 1) / threadCount, MIN_BATCHES_PER_SECONDARY);
+		commandContent.clear();
+		if (renderer->isCommandCachingEnabled()) collectCommandContent(frameInfo, batches, commandContent);
+		if (!renderer->recordSecondaryCached(frameInfo.commandBuffer, *jobSystem, batchCount, grainSize, commandContent, record)) return;
+	} else {
+		record(frameInfo.commandBuffer, 0, batchCount);
+	}
+
+	// Commands are only read once the command buffer executes, so they just have to be flushed
+	// before submission. Cached commands reuse the ones written when they were recorded.
+	if (multiDraw && batchCount > 0) {
+		ObtBuffer& indirectBuffer = indirectBuffers[frameInfo.frameIndex]->getBuffer();
+		indirectBuffer.markDirty(sizeof(VkDrawIndexedIndirectCommand) * batchCount, 0);
+		indirectBuffer.flushDirty();
+	}
+}
+
+/**
+ * Collects everything recording bakes into the command buffer, resources that are replaced or moved,
+ * like geometry pool buffers, are covered by the frame's resource version
+ */
+void SimpleRenderSystem::collectCommandContent(const FrameInfo& frameInfo, const std::vector<InstanceBatch>& batches, ObtRenderer::CommandContent& content) const {
+	content.add(frameInfo.resourceVersion, batches.size(), obtPipeline.get());
+	content.add(frameInfo.descriptorSets.size(), frameInfo.dynamicOffsets.size());
+	for (VkDescriptorSet descriptorSet : frameInfo.descriptorSets) {
+		content.add(descriptorSet);
+	}
+	for (uint32_t offset : frameInfo.dynamicOffsets) {
+		content.add(offset);
+	}
+	if (!indirectBuffers.empty()) {
+		content.add(indirectBuffers[frameInfo.frameIndex]->getGeneration(), indirectBuffers[frameInfo.frameIndex]->getBuffer().getGeneration());
+	}
+	for (const auto& batch : batches) {
+		content.add(batch.key, batch.firstInstance, batch.instanceCount);
+	}
+}
+
+void SimpleRenderSystem::recordDirect(VkCommandBuffer commandBuffer, FrameInfo& frameInfo, ObtScene& scene, const std::vector<InstanceBatch>& batches, uint32_t begin, uint32_t end) {
+	ObtDrawState state{commandBuffer};
+	for (uint32_t i = begin; i < end; i++) {
+		const auto& batch = batches[i];
+		assert(drawKeyPipeline(batch.key) == PIPELINE_DEFAULT && "Draw key references an unknown pipeline!");
+		state.bindPipeline(obtPipeline.get());
+		state.bindDescriptorSets(pipelineLayout, 0, frameInfo.descriptorSets, frameInfo.dynamicOffsets);
+
+		ObtModel* model = scene.getModel(drawKeyModel(batch.key));
+		state.bindModel(model);
+		model->draw(commandBuffer, batch.firstInstance, batch.instanceCount);
+	}
+}
+
+/**
+ * Writes the command of every batch into the frame's indirect buffer and draws each run of batches
+ * that share pass, pipeline, material and geometry pool with a single vkCmdDrawIndexedIndirect, so
+ * recording cost follows the number of state changes rather than the number of models. Batches of
+ * models outside a pool or without indices are drawn directly in between.
+ *
+ * @note Ranges write disjoint commands and may be recorded concurrently
+ */
+void SimpleRenderSystem::recordMultiDraw(VkCommandBuffer commandBuffer, FrameInfo& frameInfo, ObtScene& scene, const std::vector<InstanceBatch>& batches, uint32_t begin, uint32_t end) {
+	ObtGrowableBuffer& indirectBuffer = *indirectBuffers[frameInfo.frameIndex];
+	VkDrawIndexedIndirectCommand* commands = indirectBuffer.data<VkDrawIndexedIndirectCommand>();
 
-	vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &frameInfo.descriptorSets[0], 1, &frameInfo.dynamicOffsets);
-	vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &frameInfo.descriptorSets[1], 0, nullptr);
-	vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 2, 1, &frameInfo.descriptorSets[2], 0, nullptr);
+	auto isPooled = [](ObtModel* model) { return model->getGeometryPool() != nullptr && model->getIndexCount() > 0; };
+	uint32_t maxDrawCount = obtDevice.properties.limits.maxDrawIndirectCount;
+
+	ObtDrawState state{commandBuffer};
+	for (uint32_t first = begin; first < end;) {
+		assert(drawKeyPipeline(batches[first].key) == PIPELINE_DEFAULT && "Draw key references an unknown pipeline!");
+		state.bindPipeline(obtPipeline.get());
+		state.bindDescriptorSets(pipelineLayout, 0, frameInfo.descriptorSets, frameInfo.dynamicOffsets);
+
+		ObtModel* model = scene.getModel(drawKeyModel(batches[first].key));
+		if (!isPooled(model)) {
+			state.bindModel(model);
+			model->draw(commandBuffer, batches[first].firstInstance, batches[first].instanceCount);
+			first++;
+			continue;
+		}
+
+		// Keys are compared above the model field, which leaves pass, pipeline and material
+		ObtGeometryPool* geometryPool = model->getGeometryPool();
+		uint64_t runState = batches[first].key >> DRAW_KEY_MATERIAL_SHIFT;
+		uint32_t last = first;
+		for (; last < end && last - first < maxDrawCount; last++) {
+			const auto& batch = batches[last];
+			ObtModel* batchModel = scene.getModel(drawKeyModel(batch.key));
+			if ((batch.key >> DRAW_KEY_MATERIAL_SHIFT) != runState || !isPooled(batchModel) || batchModel->getGeometryPool() != geometryPool) break;
+
+			commands[last] = VkDrawIndexedIndirectCommand{batchModel->getIndexCount(), batch.instanceCount,
+				batchModel->getFirstIndex(), static_cast<int32_t>(batchModel->getFirstVertex()), batch.firstInstance};
+		}
+
+		state.bindGeometryPool(geometryPool);
+		vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer.getBuffer().getBuffer(), sizeof(VkDrawIndexedIndirectCommand) * first,
+			last - first, sizeof(VkDrawIndexedIndirectCommand));
+		first = last;
+	}
+}
+
+/**
+ * Draws the commands written by the GPU cull pass, one indirect count draw per model
+ */
+void SimpleRenderSystem::renderIndirect(FrameInfo& frameInfo, ObtScene& scene, GpuCullSystem& cullSystem) {
+	obtPipeline->bind(frameInfo.commandBuffer);
 
-	for (int i = 0; i < gameObjects.size(); i++) {
-		auto& obj = gameObjects[i];
+	vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0,
+		static_cast<uint32_t>(frameInfo.descriptorSets.size()), frameInfo.descriptorSets.data(),
+		static_cast<uint32_t>(frameInfo.dynamicOffsets.size()), frameInfo.dynamicOffsets.data());
 
-		obj.model->bind(frameInfo.commandBuffer);
-		obj.model->draw(frameInfo.commandBuffer, i);
+	VkBuffer commandBuffer = cullSystem.getCommandBuffer(frameInfo.frameIndex);
+	VkBuffer countBuffer = cullSystem.getCountBuffer(frameInfo.frameIndex);
+	for (const auto& batch : cullSystem.getDrawBatches()) {
+		ObtModel* model = scene.getModel(batch.modelId);
+		model->bind(frameInfo.commandBuffer);
+		obtDevice.drawIndexedIndirectCount(frameInfo.commandBuffer, commandBuffer, sizeof(VkDrawIndexedIndirectCommand) * batch.firstCommand,
+			countBuffer, sizeof(uint32_t) * batch.modelId, batch.maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
 	}
 }
 
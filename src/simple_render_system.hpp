@@ -2,9 +2,14 @@
 
 #include "obt_pipeline.hpp"
 #include "obt_device.hpp"
-#include "obt_game_object.hpp"
+#include "obt_scene.hpp"
 #include "obt_camera.hpp"
 #include "obt_frame_info.hpp"
+#include "obt_draw_keys.hpp"
+#include "obt_growable_buffer.hpp"
+#include "obt_renderer.hpp"
+#include "obt_job_system.hpp"
+#include "gpu_cull_system.hpp"
 
 #include <memory>
 #include <vector>
@@ -13,21 +18,48 @@ namespace obt {
 
 class SimpleRenderSystem {
 	public:
-		SimpleRenderSystem(ObtDevice& device, VkRenderPass renderPass, std::vector<VkDescriptorSetLayout>& descriptorSetLayouts);
+		// Only the opaque pass and this system's single pipeline exist so far, objects have no materials
+		static constexpr uint32_t PASS_OPAQUE = 0;
+		static constexpr uint32_t PIPELINE_DEFAULT = 0;
+		static constexpr uint32_t MATERIAL_DEFAULT = 0;
+		// Fewer batches are not worth a secondary command buffer of their own
+		static constexpr uint32_t MIN_BATCHES_PER_SECONDARY = 64;
+
+		// Visible objects sharing a draw key state, drawn as one instanced draw
+		struct InstanceBatch {
+			uint64_t key;
+			uint32_t firstInstance;
+			uint32_t instanceCount;
+		};
+
+		SimpleRenderSystem(ObtDevice& device, VkRenderPass renderPass, std::vector<VkDescriptorSetLayout>& descriptorSetLayouts, uint32_t framesInFlight);
 		~SimpleRenderSystem();
 
 		SimpleRenderSystem(const SimpleRenderSystem&) = delete;
 		SimpleRenderSystem &operator=(const SimpleRenderSystem&) = delete;
 
-		void renderGameObjects(FrameInfo& frameInfo, std::vector<ObtGameObject>& gameObjects);
+		void sortDraws(const ObtScene& scene, const ObtCamera& camera, const std::vector<uint32_t>& visibleObjects, std::vector<uint32_t>& instances, std::vector<InstanceBatch>& batches);
+		void renderScene(FrameInfo& frameInfo, ObtScene& scene, const std::vector<InstanceBatch>& batches, ObtRenderer* renderer = nullptr, ObtJobSystem* jobSystem = nullptr);
+		void renderIndirect(FrameInfo& frameInfo, ObtScene& scene, GpuCullSystem& cullSystem);
 
 	private:
 		void createPipelineLayout(std::vector<VkDescriptorSetLayout>& descriptorSetLayouts);
 		void createPipeline(VkRenderPass renderPass);
+		void recordDirect(VkCommandBuffer commandBuffer, FrameInfo& frameInfo, ObtScene& scene, const std::vector<InstanceBatch>& batches, uint32_t begin, uint32_t end);
+		void collectCommandContent(const FrameInfo& frameInfo, const std::vector<InstanceBatch>& batches, ObtRenderer::CommandContent& content) const;
+		void recordMultiDraw(VkCommandBuffer commandBuffer, FrameInfo& frameInfo, ObtScene& scene, const std::vector<InstanceBatch>& batches, uint32_t begin, uint32_t end);
 
 		ObtDevice& obtDevice;
 		std::unique_ptr<ObtPipeline> obtPipeline;
 		VkPipelineLayout pipelineLayout;
+
+		std::vector<ObtDrawItem> drawItems;
+		std::vector<ObtDrawItem> drawItemScratch;
+
+		// Per frame draw commands, the command of a batch is at the batch's index
+		std::vector<std::unique_ptr<ObtGrowableBuffer>> indirectBuffers;
+		// Reused every frame to compare against the renderer's cached commands
+		ObtRenderer::CommandContent commandContent;
 };
 
 }